@@ -86,7 +86,7 @@ constexpr auto DEPTH_ADJUST = 0;
 #define TRANSPOSITION_TABLE_FAKE_CLEAN
 // #define TRANSPOSITION_TABLE_FAKE_CLEAN_NOT_EXACT_ONLY
 // #define TRANSPOSITION_TABLE_64BIT_KEY
-// #define TT_MOVE_ENABLE
+#define TT_MOVE_ENABLE
 // #define TRANSPOSITION_TABLE_DEBUG
 #endif
 
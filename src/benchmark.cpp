@@ -0,0 +1,143 @@
+// This file is part of Sanmill.
+// Copyright (C) 2019-2024 The Sanmill developers (see AUTHORS file)
+//
+// Sanmill is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Sanmill is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "position.h"
+#include "rule.h"
+
+using std::istream;
+using std::string;
+using std::vector;
+
+namespace {
+
+// Placing, remove-pending, moving and flying positions for every rule of
+// RULES[], in the same order. Rules which do not allow flying have no flying
+// position.
+const vector<string> Defaults[N_RULES] = {
+    // Nine Men's Morris
+    {
+        "O*******/@*O*O*@*/@*O*O*@* b p p 5 4 4 5 0 0 0 5",
+        "O*O*@***/@*O*O*@*/@*O*O*@* w p r 6 3 5 4 1 0 0 6",
+        "O*O**O**/@@O@O**O/*@O*O*** b m s 8 0 4 0 0 0 0 19",
+        "O*O*O***/*@O@O**O/@@O*O*** w m r 8 0 4 0 1 0 2 20",
+        "O@O*O***/O@O@O***/**O*O*** b m s 8 0 3 0 0 0 2 21",
+    },
+    // Twelve Men's Morris
+    {
+        "********/@@*OOOO*/******** b p p 4 8 2 9 0 0 0 4",
+        "********/@@*OOOO@/******** b p r 4 8 3 8 0 1 0 5",
+        "*@@*@***/O*O****O/O***O*** w m s 5 0 3 0 0 0 22 47",
+        "O@@@*O@O/@*OOO@*@/OOO@@O@@ b m r 10 0 11 0 0 1 4 16",
+        "@*@**@*O/O**O****/O******* b m s 4 0 3 0 0 0 7 51",
+    },
+    // Dooz
+    {
+        "********/@OO@@OO@/O******* b p p 5 7 4 8 0 0 0 5",
+        "*@@OOO@@/@OO@@OO*/OOO@@O@O w p r 12 0 10 0 1 0 0 12",
+        "**@@O***/O*@O@*@*/O*@O**** w m s 5 0 6 0 0 0 6 41",
+        "*@@@O***/O**O@*@*/*O@*O*** b m r 5 0 6 0 0 1 14 44",
+        "@@**O*O*/**@O@*@*/**@***** w m s 3 0 6 0 0 0 2 54",
+    },
+    // Lasker Morris
+    {
+        "O*@*O***/@*@*O*O*/@*O*@*** w p p 5 5 5 5 0 0 0 6",
+        "O*O*@*@*/OOOO@@@*/O@O*O*@* w p r 9 0 7 1 1 0 0 12",
+        "@*****O*/@@*OOOO*/O******* w m s 6 0 3 0 0 0 2 36",
+        "@**OO*O*/@@@O*OO@/******OO w m r 8 0 5 0 1 0 2 29",
+        "**O@****/O*O*@*O*/O*@O*O** b m s 7 0 3 0 0 0 26 38",
+    },
+    // Cheng San Qi
+    {
+        "@*O*****/@*O*@*O*/O*@*O*** b p p 5 4 4 5 0 0 0 5",
+        "O***O*O*/@@O@OOO@/@*@*O*@* b p r 8 1 7 1 0 1 0 9",
+        "**O*@*@@/@O*@@OOO/O*@**O@* w m s 7 0 8 0 0 0 5 19",
+        "*@@@*O**/@*O@@OO*/O*@O*@** b m r 6 0 8 0 0 1 12 53",
+    },
+    // Da San Qi
+    {
+        "********/*OO@OO@@/O*@***** b p p 5 7 4 8 0 0 0 5",
+        "O*@*@*O*/OOO@OO@X/O@@@O@@O b p r 10 2 9 2 0 1 0 11",
+        "O@@O@**O/OO*OOO@*/O***@*** b m s 9 0 5 0 0 0 0 26",
+        "O@@O@*@O/OO*OOO@O/**@@**** w m r 9 0 7 0 1 0 4 24",
+    },
+    // Zhi Qi
+    {
+        "****O***/@*O@@O@O/O***@*** w p p 5 7 5 7 0 0 0 6",
+        "OO@*OO@@/@@O@@O@O/O@OO@OO@ w p r 12 0 11 1 1 0 0 12",
+        "**O*@@@@/@***@*OO/@@**@O@O b m s 5 0 10 0 0 0 2 29",
+        "OO**@*@@/@@@*@@OO/@O**@O@O b m r 7 0 11 0 0 1 2 25",
+        "@*@O@@**/***O@*@*/***O**@* w m s 3 0 7 0 0 0 1 38",
+    },
+    // Experimental
+    {
+        "********/O*@OO@*@/**O*@*** w p p 4 8 4 8 0 0 0 5",
+        "O*@*@*@*/O*OOO@@@/OOO*@*@* b p r 8 3 8 3 0 1 0 10",
+        "*@@@**@O/OOO***@@/O**@@@@O w m s 6 0 10 0 0 0 0 20",
+        "O@******/O*O@**@@/*O*@@@@* b m r 4 0 8 0 0 1 2 26",
+    },
+};
+
+} // namespace
+
+/// setup_bench() builds a list of UCI commands to be run by bench. There
+/// are four parameters: the search depth, the number of search threads, the
+/// TT size in MB and the search algorithm (0 = Alpha-Beta, 1 = PVS,
+/// 2 = MTD(f), 3 = MCTS, 4 = Random). The positions of every rule are
+/// preceded by a "rule" command, which is not part of UCI and is handled by
+/// bench itself.
+///
+/// bench           -> search the default positions up to depth 10
+/// bench 8 4 256 1 -> PVS up to depth 8 with 4 threads and a 256 MB TT
+
+vector<string> setup_bench(Position *, istream &is)
+{
+    vector<string> list;
+    string go;
+
+    // Assign default values to missing arguments
+    const string depth = (is >> go) ? go : "10";
+    const string threads = (is >> go) ? go : "1";
+    const string ttSize = (is >> go) ? go : "16";
+    const string algorithm = (is >> go) ? go : "2";
+
+    // The search depth is the skill level once the developer mode and the
+    // human experience are turned off, see Mills::get_search_depth().
+    list.emplace_back("setoption name Threads value " + threads);
+    list.emplace_back("setoption name Hash value " + ttSize);
+    list.emplace_back("setoption name Algorithm value " + algorithm);
+    list.emplace_back("setoption name SkillLevel value " + depth);
+    list.emplace_back("setoption name MoveTime value 0");
+    list.emplace_back("setoption name DeveloperMode value false");
+    list.emplace_back("setoption name DrawOnHumanExperience value false");
+    list.emplace_back("setoption name AiIsLazy value false");
+    list.emplace_back("setoption name Shuffling value false");
+
+    for (int r = 0; r < N_RULES; r++) {
+        list.emplace_back("rule " + std::to_string(r));
+        list.emplace_back("ucinewgame");
+
+        for (const string &fen : Defaults[r]) {
+            list.emplace_back("position fen " + fen);
+            list.emplace_back("go");
+        }
+    }
+
+    return list;
+}
@@ -15,153 +15,244 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cmath>
+#include <cstring>
+#include <deque>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <mutex>
-#include <stack>
 #include <thread>
 #include <vector>
 
+#include "bitboard.h"
 #include "mcts.h"
+#include "misc.h"
 #include "movepick.h"
 #include "option.h"
 #include "position.h"
+#include "rule.h"
 #include "search.h"
+#include "thread.h"
 #include "types.h"
 #include "uci.h"
 
-Value MTDF(Position *pos, Sanmill::Stack<Position> &ss, Value firstguess,
-           Depth depth, Depth originDepth, Move &bestMove);
+Value MTDF(Position *pos, Value firstguess, Depth depth, Depth originDepth,
+           Move &bestMove);
 
-Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth,
-              Depth originDepth, Value alpha, Value beta, Move &bestMove);
+Value qsearch(Position *pos, Depth depth, Depth originDepth, Value alpha,
+              Value beta, Move &bestMove);
 
 using namespace std;
 
-class ThreadSafeNodeVisits
+// Class representing a node in the Monte Carlo Tree Search. The nodes do not
+// store positions: the position of a node is made by playing the moves of the
+// path from the root. The children of a node are allocated together from the
+// arena of the search and published once by the thread which expands it, so
+// the node only needs the address of the first one and their number. The
+// wins of a node are those of the player who made its move. Once the result
+// of the position is proven, the winner is set and never changes.
+class Node
 {
 public:
-    explicit ThreadSafeNodeVisits(size_t initial_size)
-        : node_visits_(initial_size, 0)
-        , node_wins_(initial_size, 0)
-    { }
+    enum State : uint8_t { LEAF, EXPANDING, EXPANDED };
 
-    void increment_visits(int move_index, uint32_t visits)
+    double win_score() const
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        node_visits_[move_index] += visits;
+        const uint32_t n = visits.load(std::memory_order_relaxed);
+        if (n == 0)
+            return 0;
+        return static_cast<double>(wins.load(std::memory_order_relaxed)) / n;
     }
 
-    void increment_wins(int move_index, uint32_t wins)
-    {
-        std::unique_lock<std::mutex> lock(mutex_);
-        node_wins_[move_index] += wins;
-    }
+    std::atomic<uint32_t> visits {0};
+    std::atomic<uint32_t> wins {0};
+    Node *children {nullptr};
+    Move move {MOVE_NONE};
+    uint8_t child_count {0};
+    uint8_t move_index {0};
+    std::atomic<State> state {LEAF};
+    std::atomic<Color> winner {NOCOLOR};
+#ifdef MCTS_ALPHA_BETA
+    std::atomic<Depth> alpha_beta_depth {1};
+#endif // MCTS_ALPHA_BETA
+};
 
-    uint32_t visits(int move_index)
+// Bump allocator of the nodes of one search. Nodes are never freed one by
+// one: the blocks are released together with the tree, and the addresses of
+// the nodes stay valid until then.
+class NodeArena
+{
+public:
+    Node *allocate(int n)
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        return node_visits_[move_index];
-    }
+        std::lock_guard<std::mutex> lock(mutex_);
 
-    uint32_t wins(int move_index)
-    {
-        std::unique_lock<std::mutex> lock(mutex_);
-        return node_wins_[move_index];
+        if (used_ + n > BLOCK_SIZE) {
+            blocks_.emplace_back(new Node[BLOCK_SIZE]);
+            used_ = 0;
+        }
+
+        Node *nodes = &blocks_.back()[used_];
+        used_ += n;
+        return nodes;
     }
 
 private:
-    std::vector<uint32_t> node_visits_;
-    std::vector<uint32_t> node_wins_;
+    static constexpr int BLOCK_SIZE = 1 << 14;
+    static_assert(BLOCK_SIZE >= MAX_MOVES, "a block must hold all children");
+
+    std::vector<std::unique_ptr<Node[]>> blocks_;
+    int used_ {BLOCK_SIZE};
     std::mutex mutex_;
 };
 
-// Class representing a node in the Monte Carlo Tree Search
-class Node
+// The tree shared by the threads of one search, with the budget of
+// iterations they take their iterations from. It is kept after the search
+// with its root position and rules, for the next search to start from the
+// subtree of its own position.
+struct Tree
 {
-public:
-    Node(Position *pos, Move m, Node *prt, int idx)
-        : position(pos)
-        , move(m)
-        , parent(prt)
-        , move_index(idx)
-    { }
+    Node root;
+    NodeArena arena;
+    Position position;
+    Rule rules;
+    std::atomic<int> iterations {0};
+    int max_iterations {0};
+    std::atomic<bool> stop {false};
+    std::chrono::steady_clock::time_point start_time;
+    int move_time {0};
+};
 
-    double win_score() const
-    {
-        if (num_visits == 0)
-            return 0;
-        return static_cast<double>(num_wins) / num_visits;
+// The tree of the running search, for the helper threads of the pool to join
+Tree *currentTree = nullptr;
+
+// The tree of the last completed search of this thread
+thread_local std::unique_ptr<Tree> keptTree;
+
+// Find the node of the position with the given key in the first plies below
+// node, whose position is pos
+const Node *find_node(const Node *node, Position &pos, Key key, int plies)
+{
+    if (pos.key() == key) {
+        return node;
     }
 
-    void increment_visits() { ++num_visits; }
+    if (plies == 0 || node->state.load() != Node::EXPANDED) {
+        return nullptr;
+    }
 
-    void increment_wins() { ++num_wins; }
+    for (int i = 0; i < node->child_count; i++) {
+        const Node *child = &node->children[i];
+        StateInfo st;
+
+        pos.do_move(child->move, st);
+        const Node *found = find_node(child, pos, key, plies - 1);
+        pos.undo_move(child->move);
+
+        if (found != nullptr) {
+            return found;
+        }
+    }
 
-    void add_child(Node *child) { children.emplace_back(child); }
+    return nullptr;
+}
 
-    Position *position {nullptr};
-    Move move;
-    Node *parent {nullptr};
-    std::vector<Node *> children;
-    uint32_t num_visits {0};
-    uint32_t num_wins {0};
-    int move_index {0};
+// Copy node and its subtree to copy, allocating the children from arena
+void copy_subtree(NodeArena &arena, const Node &node, Node &copy)
+{
+    copy.visits = node.visits.load();
+    copy.wins = node.wins.load();
+    copy.move = node.move;
+    copy.move_index = node.move_index;
+    copy.state = node.state.load();
+    copy.winner = node.winner.load();
 #ifdef MCTS_ALPHA_BETA
-    Depth alpha_beta_depth {1};
-    Node *best_alpha_beta_child {nullptr};
-    double last_bonus_given {0.0};
+    copy.alpha_beta_depth = node.alpha_beta_depth.load();
 #endif // MCTS_ALPHA_BETA
-};
 
-// Recursively delete tree starting from the given node
-void delete_tree(Node *root)
-{
-    std::stack<Node *> nodes;
-    nodes.push(root);
+    if (node.child_count > 0) {
+        copy.children = arena.allocate(node.child_count);
+        copy.child_count = node.child_count;
 
-    while (!nodes.empty()) {
-        Node *node = nodes.top();
-        nodes.pop();
+        for (int i = 0; i < node.child_count; i++) {
+            copy_subtree(arena, node.children[i], copy.children[i]);
+        }
+    }
+}
 
-        for (Node *child : node->children) {
-            nodes.push(child);
+// Return a tree for the search of pos. If the kept tree was grown with the
+// same rules and pos is found in its first plies, the subtree of pos is moved
+// to a new tree and the rest is freed with the old one. If pos is the root of
+// the kept tree, as in repeated searches of one position, the tree is kept as
+// it is.
+std::unique_ptr<Tree> reuse_tree(const Position &pos)
+{
+    std::unique_ptr<Tree> old = std::move(keptTree);
+    std::unique_ptr<Tree> tree;
+
+    if (old != nullptr && std::memcmp(&old->rules, &rule, sizeof(Rule)) == 0) {
+        if (const Node *node = find_node(&old->root, old->position, pos.key(),
+                                         REUSE_PLIES)) {
+            if (node == &old->root) {
+                tree = std::move(old);
+                tree->iterations = 0;
+                tree->stop = false;
+            } else {
+                tree = std::make_unique<Tree>();
+                copy_subtree(tree->arena, *node, tree->root);
+            }
         }
+    }
 
-        delete node->position;
-        delete node;
+    if (tree == nullptr) {
+        tree = std::make_unique<Tree>();
     }
+
+    tree->position = pos;
+    std::memcpy(&tree->rules, &rule, sizeof(Rule));
+
+    return tree;
 }
 
 // Compute the UCT (Upper Confidence Bound for Trees) value tuned for a node
-double uct_value_tuned(const Node *node, double exploration_parameter)
+double uct_value_tuned(const Node *node, uint32_t parent_visits,
+                       double exploration_parameter)
 {
-    if (node->num_visits == 0) {
+    const uint32_t visits = node->visits.load(std::memory_order_relaxed);
+
+    if (visits == 0) {
         return std::numeric_limits<double>::max();
     }
 
-    double mean = node->win_score();
+    double mean = std::min(node->win_score(), 1.0);
     double exploration_term = exploration_parameter *
-                              std::sqrt(2 * std::log(node->parent->num_visits) /
-                                        node->num_visits);
-    double variance_term = std::sqrt((mean * (1 - mean)) / node->num_visits);
+                              std::sqrt(2 * std::log(parent_visits) / visits);
+    double variance_term = std::sqrt((mean * (1 - mean)) / visits);
     double bias_term = BIAS_FACTOR *
                        static_cast<double>(MAX_MOVES - node->move_index);
 
     return mean + exploration_term + variance_term + bias_term;
 }
 
-// Return the best child node according to UCT value tuned
-Node *best_uct_child_tuned(Node *node, double exploration_parameter)
+// Return the best child node according to UCT value tuned, or nullptr if all
+// moves are proven to lose for us, the side to move
+Node *best_uct_child_tuned(Node *node, Color us, double exploration_parameter)
 {
     Node *best_child = nullptr;
     double best_value = std::numeric_limits<double>::lowest();
+    const uint32_t parent_visits = node->visits.load(std::memory_order_relaxed);
 
     // Loop through all child nodes and find the one with the highest UCT value
-    for (Node *child : node->children) {
-        double value = uct_value_tuned(child, exploration_parameter);
+    for (int i = 0; i < node->child_count; i++) {
+        Node *child = &node->children[i];
+        if (child->winner.load(std::memory_order_relaxed) == ~us) {
+            continue;
+        }
+        double value = uct_value_tuned(child, parent_visits,
+                                       exploration_parameter);
         if (value > best_value) {
             best_value = value;
             best_child = child;
@@ -171,61 +262,450 @@ Node *best_uct_child_tuned(Node *node, double exploration_parameter)
     return best_child;
 }
 
-// Select the next node to expand
-Node *select(Node *node, double exploration_parameter)
+// Expand the node, whose position is pos, by adding child nodes for all legal
+// moves, and return the first of them. Only one thread expands a node: the
+// others, and the nodes without moves, return nullptr and simulate the node
+// itself.
+Node *expand(Tree &tree, Node *node, Position &pos)
 {
-    while (!node->children.empty()) {
-        node = best_uct_child_tuned(node, exploration_parameter);
-    }
-    return node;
-}
+    Node::State expected = Node::LEAF;
 
-// Expand the current node by adding child nodes for all legal moves
-Node *expand(Node *node)
-{
-    Position *pos = node->position;
+    if (!node->state.compare_exchange_strong(expected, Node::EXPANDING,
+                                             std::memory_order_acquire)) {
+        return nullptr;
+    }
 
-    MovePicker mp(*pos);
+    MovePicker mp(pos);
     mp.next_move(); // Sort moves
     // const int moveCount = std::max(mp.move_count() / SEARCH_PRUNING_FACTOR,
     // 1);
     const int moveCount = mp.move_count();
 
     // Add child nodes for each sorted legal move
-    for (int i = 0; i < moveCount; i++) {
-        Position *child_position = new Position(*pos);
-        const Move move = mp.moves[i].move;
-        child_position->do_move(move);
+    if (moveCount > 0) {
+        node->children = tree.arena.allocate(moveCount);
+
+        for (int i = 0; i < moveCount; i++) {
+            node->children[i].move = mp.moves[i].move;
+            node->children[i].move_index = static_cast<uint8_t>(i);
+        }
+    }
+
+    node->child_count = static_cast<uint8_t>(moveCount);
+    node->state.store(Node::EXPANDED, std::memory_order_release);
+
+    return moveCount > 0 ? node->children : nullptr;
+}
 
-        Node *child = new Node(child_position, move, node, i);
-        node->add_child(child);
+// Return the square of the n-th set bit of b
+Square nth_square(Bitboard b, int n)
+{
+    while (n-- > 0) {
+        b &= b - 1;
     }
 
-    return node->children.empty() ? node : node->children.front();
+    return static_cast<Square>(popcount((b & (0 - b)) - 1));
 }
 
-// Simulate a game from the given node and return whether it resulted in a win
-bool simulate(Node *node, Sanmill::Stack<Position> &ss)
+// Minimal state of a random playout: the pieces of both sides, the marked
+// squares, the pieces in hand and the removals due. The moves are made with
+// the adjacency and mill tables directly instead of the rules code of
+// Position, but in the same order of events as Position::put_piece() and
+// Position::remove_piece(). Only the rules of supported() are played, the
+// threefold repetition is not detected.
+class Playout
 {
-    Position *pos = node->position;
+public:
+    explicit Playout(const Position &pos)
+        : marked(pos.byTypeBB[MARKED])
+        , toRemove(std::max(pos.piece_to_remove_count(pos.side_to_move()), 0))
+        , quietPlies(static_cast<int>(pos.rule50_count()))
+        , sideToMove(pos.side_to_move())
+        , placing(pos.get_phase() == Phase::ready ||
+                  pos.get_phase() == Phase::placing)
+    {
+        for (Color c : {WHITE, BLACK}) {
+            byColor[c] = pos.byColorBB[c];
+            inHand[c] = pos.piece_in_hand_count(c);
+        }
+    }
+
+    // Whether the playouts follow the current rule. The other placing phase
+    // mill actions, moving in the placing phase, removals because of a full
+    // board and removals because of a stalemate are left to the search.
+    static bool supported()
+    {
+        return (rule.millFormationActionInPlacingPhase ==
+                    MillFormationActionInPlacingPhase::
+                        removeOpponentsPieceFromBoard ||
+                rule.millFormationActionInPlacingPhase ==
+                    MillFormationActionInPlacingPhase::
+                        markAndDelayRemovingPieces) &&
+               !rule.mayMoveInPlacingPhase &&
+               (rule.boardFullAction == BoardFullAction::firstPlayerLose ||
+                rule.boardFullAction == BoardFullAction::agreeToDraw) &&
+               (rule.stalemateAction == StalemateAction::endWithStalemateLoss ||
+                rule.stalemateAction == StalemateAction::changeSideToMove ||
+                rule.stalemateAction == StalemateAction::endWithStalemateDraw);
+    }
+
+    // Play random moves to the end of the game and return the winner, or
+    // DRAW when the game is drawn
+    Color play(PRNG &rng)
+    {
+        Color winner = toRemove > 0 ? NOCOLOR : game_over();
+
+        while (winner == NOCOLOR) {
+            plies++;
+            winner = toRemove > 0 ? remove(rng) : move(rng);
+        }
+
+        return winner;
+    }
+
+    // The moves and removals played
+    int played() const { return plies; }
+
+private:
+    static constexpr Bitboard BOARD_BB = 0xFFFFFF00;
+
+    static Square random_square(Bitboard b, PRNG &rng)
+    {
+        return nth_square(b, static_cast<int>(rng.rand<uint64_t>() %
+                                              popcount(b)));
+    }
+
+    // Place or move a piece of the side to move, and return the winner if
+    // that ends the game
+    Color move(PRNG &rng)
+    {
+        const Color us = sideToMove;
+        const Bitboard empty = ~(byColor[WHITE] | byColor[BLACK] | marked) &
+                               BOARD_BB;
+        Square to;
+
+        if (placing) {
+            if (inHand[us] == 0 || !empty) {
+                return DRAW;
+            }
+            to = random_square(empty, rng);
+            inHand[us]--;
+            byColor[us] |= square_bb(to);
+        } else {
+            Square from = SQ_NONE;
+            random_move(us, empty, rng, from, to);
+            byColor[us] ^= square_bb(from) | square_bb(to);
+            quietPlies++;
+        }
+
+        toRemove = mills(us, to);
+        if (toRemove > 0) {
+            if (!rule.mayRemoveMultiple) {
+                toRemove = 1;
+            }
+            return NOCOLOR;
+        }
+
+        // The board is full at the end of the placing phase
+        if (placing && rule.pieceCount == 12 &&
+            popcount(byColor[WHITE] | byColor[BLACK]) >= SQUARE_NB) {
+            return rule.boardFullAction == BoardFullAction::firstPlayerLose ?
+                       BLACK :
+                       DRAW;
+        }
+
+        if (!end_placing()) {
+            sideToMove = ~sideToMove;
+        }
+
+        return game_over();
+    }
+
+    // Remove a piece of the opponent, and return the winner if that ends the
+    // game
+    Color remove(PRNG &rng)
+    {
+        const Color us = sideToMove;
+        const Color them = ~us;
+        const Bitboard bb = removable(them);
+
+        if (!bb) {
+            return DRAW;
+        }
+
+        const Square s = random_square(bb, rng);
+        byColor[them] ^= square_bb(s);
+        if (placing &&
+            rule.millFormationActionInPlacingPhase ==
+                MillFormationActionInPlacingPhase::markAndDelayRemovingPieces) {
+            marked |= square_bb(s);
+        }
+        quietPlies = 0;
+
+        if (popcount(byColor[them]) + inHand[them] <
+            rule.piecesAtLeastCount) {
+            return us;
+        }
+
+        if (--toRemove > 0) {
+            return NOCOLOR;
+        }
+
+        if (!end_placing()) {
+            sideToMove = them;
+        }
+
+        return inHand[sideToMove] == 0 ? game_over() : NOCOLOR;
+    }
+
+    // Start the moving phase once the pieces in hand are placed, like
+    // Position::handle_placing_phase_end(). Return false if it goes on.
+    bool end_placing()
+    {
+        if (!placing || inHand[WHITE] > 0 || inHand[BLACK] > 0) {
+            return false;
+        }
+
+        placing = false;
+        marked = 0;
+        sideToMove = rule.isDefenderMoveFirst ? BLACK : WHITE;
+        return true;
+    }
+
+    // Check the N-move rules and a stalemate of the side to move, as the
+    // search and Position::check_if_game_is_over() do. Return the winner if
+    // the game is over.
+    Color game_over()
+    {
+        if (placing) {
+            return NOCOLOR;
+        }
+
+        if (quietPlies > static_cast<int>(rule.nMoveRule) ||
+            (rule.endgameNMoveRule < rule.nMoveRule &&
+             (popcount(byColor[WHITE]) == 3 ||
+              popcount(byColor[BLACK]) == 3) &&
+             quietPlies >= static_cast<int>(rule.endgameNMoveRule))) {
+            return DRAW;
+        }
+
+        if (!surrounded(sideToMove)) {
+            return NOCOLOR;
+        }
+
+        switch (rule.stalemateAction) {
+        case StalemateAction::changeSideToMove:
+            sideToMove = ~sideToMove;
+            return surrounded(sideToMove) ? DRAW : NOCOLOR;
+        case StalemateAction::endWithStalemateDraw:
+            return DRAW;
+        default:
+            return ~sideToMove;
+        }
+    }
+
+    // Whether c has no move, like Position::is_all_surrounded()
+    bool surrounded(Color c) const
+    {
+        const Bitboard occupied = byColor[WHITE] | byColor[BLACK];
+
+        if (popcount(occupied) >= SQUARE_NB) {
+            return true;
+        }
+
+        if (rule.mayFly && popcount(byColor[c]) <= rule.flyPieceCount) {
+            return false;
+        }
+
+        for (Bitboard b = byColor[c]; b; b &= b - 1) {
+            const Square s = nth_square(b, 0);
+            if (MoveList<LEGAL>::adjacentSquaresBB[s] & ~occupied) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // The number of mills of c through s
+    int mills(Color c, Square s) const
+    {
+        int n = 0;
+        for (int d = 0; d < LD_NB; d++) {
+            const Bitboard line = Position::millTableBB[s][d];
+            if ((byColor[c] & line) == line) {
+                n++;
+            }
+        }
+        return n;
+    }
+
+    // The pieces of c which may be removed: those which are not in a mill,
+    // unless all of them are
+    Bitboard removable(Color c) const
+    {
+        if (rule.mayRemoveFromMillsAlways) {
+            return byColor[c];
+        }
+
+        Bitboard free = 0;
+        for (Bitboard b = byColor[c]; b; b &= b - 1) {
+            const Square s = nth_square(b, 0);
+            if (mills(c, s) == 0) {
+                free |= square_bb(s);
+            }
+        }
+        return free ? free : byColor[c];
+    }
+
+    // Pick a random move of a piece of us, to an adjacent empty square or to
+    // any of them when flying. The side to move is not surrounded.
+    void random_move(Color us, Bitboard empty, PRNG &rng, Square &from,
+                     Square &to) const
+    {
+        const bool flying = rule.mayFly &&
+                            popcount(byColor[us]) <= rule.flyPieceCount;
+        Square froms[SQUARE_NB];
+        Bitboard targets[SQUARE_NB];
+        int n = 0;
+        int count = 0;
+
+        for (Bitboard b = byColor[us]; b; b &= b - 1) {
+            const Square s = nth_square(b, 0);
+            const Bitboard t = flying ?
+                                   empty :
+                                   MoveList<LEGAL>::adjacentSquaresBB[s] &
+                                       empty;
+            if (t) {
+                froms[n] = s;
+                targets[n++] = t;
+                count += popcount(t);
+            }
+        }
+
+        assert(count > 0);
+        int k = static_cast<int>(rng.rand<uint64_t>() % count);
+
+        for (int i = 0;; i++) {
+            const int c = popcount(targets[i]);
+            if (k < c) {
+                from = froms[i];
+                to = nth_square(targets[i], k);
+                return;
+            }
+            k -= c;
+        }
+    }
+
+    Bitboard byColor[COLOR_NB] {0};
+    Bitboard marked;
+    int inHand[COLOR_NB] {0};
+    int toRemove;
+    int quietPlies;
+    int plies {0};
+    Color sideToMove;
+    bool placing;
+};
+
+// Simulate a game from the given position and return its value for the side
+// to move
+Value simulate(Position &pos)
+{
+    // A playout only samples the result, so it must not look like a mate. The
+    // end of the game is left to the search, which proves it.
+    if (gameOptions.getMctsRandomPlayout() &&
+        pos.get_phase() != Phase::gameOver && Playout::supported()) {
+        thread_local PRNG rng(
+            1070372 + std::hash<std::thread::id>()(std::this_thread::get_id()));
+        Playout playout(pos);
+        const Color winner = playout.play(rng);
+
+        // The plies of a playout count as the nodes of a search
+        if (Thread *th = pos.this_thread()) {
+            th->nodes.fetch_add(static_cast<uint64_t>(playout.played()),
+                                std::memory_order_relaxed);
+        }
+
+        return winner == pos.side_to_move() ? VALUE_EACH_PIECE :
+               winner == ~pos.side_to_move() ? -VALUE_EACH_PIECE :
+                                               VALUE_DRAW;
+    }
 
     Move bestMove {MOVE_NONE};
 
-    Value value = qsearch(pos, ss, ALPHA_BETA_DEPTH, ALPHA_BETA_DEPTH,
-                          -VALUE_INFINITE, VALUE_INFINITE, bestMove);
+    return qsearch(&pos, ALPHA_BETA_DEPTH, ALPHA_BETA_DEPTH, -VALUE_INFINITE,
+                   VALUE_INFINITE, bestMove);
+}
+
+// Whether the value of a simulation is a mate found by the search, so the
+// result of the position is proven. VALUE_UNIQUE only tells that the position
+// has a single move.
+bool is_proven(Value value)
+{
+    return std::abs(value) >= VALUE_MATE && std::abs(value) < VALUE_UNIQUE;
+}
+
+// Set the winner of the node, unless another thread has set it already
+void set_winner(Node *node, Color winner)
+{
+    Color expected = NOCOLOR;
+    node->winner.compare_exchange_strong(expected, winner,
+                                         std::memory_order_relaxed);
+}
+
+// Prove the node from its children, where us is the side to move: it is won if
+// one of the moves wins, and lost if all of them lose. Return the winner, or
+// NOCOLOR if the result is still open.
+Color prove(Node *node, Color us)
+{
+    if (node->state.load(std::memory_order_acquire) != Node::EXPANDED ||
+        node->child_count == 0) {
+        return NOCOLOR;
+    }
+
+    Color winner = ~us;
 
-    return value > 0;
+    for (int i = 0; i < node->child_count; i++) {
+        const Color w = node->children[i].winner.load(
+            std::memory_order_relaxed);
+        if (w == us) {
+            winner = us;
+            break;
+        }
+        if (w != ~us) {
+            winner = NOCOLOR;
+        }
+    }
+
+    if (winner != NOCOLOR) {
+        set_winner(node, winner);
+    }
+
+    return winner;
+}
+
+// Back propagate the results of the simulation up the path, taking back the
+// virtual losses added by the selection. sides holds the side to move of each
+// node, and the win goes to the nodes whose move the winner made.
+void backpropagate(const std::vector<Node *> &path,
+                   const std::vector<Color> &sides, Color winner)
+{
+    for (size_t i = path.size(); i-- > 0;) {
+        path[i]->visits.fetch_sub(VIRTUAL_LOSS - 1, std::memory_order_relaxed);
+        if (i > 0 && sides[i - 1] == winner)
+            path[i]->wins.fetch_add(1, std::memory_order_relaxed);
+    }
 }
 
-// Back propagate the results of the simulation up the tree
-void backpropagate(Node *node, bool win)
+// Back up the proof of the last node of the path towards the root, as far as
+// the parents are proven by it
+void backup_proof(const std::vector<Node *> &path,
+                  const std::vector<Color> &sides)
 {
-    while (node != nullptr) {
-        node->increment_visits();
-        if (win)
-            node->increment_wins();
-        win = !win;
-        node = node->parent;
+    for (size_t i = path.size() - 1; i-- > 0;) {
+        if (prove(path[i], sides[i]) == NOCOLOR) {
+            break;
+        }
     }
 }
 
@@ -239,13 +719,13 @@ bool should_use_alpha_beta(const Node *node)
     const int visit_count_threshold = 0;
 
     return node->alpha_beta_depth < alpha_beta_depth_threshold ||
-           node->num_visits > visit_count_threshold;
+           node->visits > visit_count_threshold;
 }
 #endif // MCTS_ALPHA_BETA
 
 #ifdef MCTS_PRINT_STAT
-void print_stats(const MovePicker &mp, ThreadSafeNodeVisits &shared_visits,
-                 Move bestMove, Value best_value, double win_score)
+void print_stats(const Node &root, Move bestMove, Value best_value,
+                 double win_score)
 {
     uint32_t total_visits = 0;
 
@@ -257,13 +737,14 @@ void print_stats(const MovePicker &mp, ThreadSafeNodeVisits &shared_visits,
               << "    " << std::setw(6) << "Wins"
               << "    " << std::setw(6) << "Visits" << '\n';
     std::cout << "----------------------------------------\n";
-    for (int i = 0; i < mp.move_count(); ++i) {
-        uint32_t visits = shared_visits.visits(i);
+    for (int i = 0; i < root.child_count; ++i) {
+        const Node &child = root.children[i];
+        uint32_t visits = child.visits;
         total_visits += visits;
-        uint32_t wins = shared_visits.wins(i);
+        uint32_t wins = child.wins;
         double win_rate = static_cast<double>(wins) / visits;
 
-        std::string move_str = UCI::move(mp.moves[i].move);
+        std::string move_str = UCI::move(child.move);
 
         std::cout << std::setw(5) << move_str << "    " << std::setw(9)
                   << std::fixed << std::setprecision(6) << win_rate << "    "
@@ -282,77 +763,133 @@ void print_stats(const MovePicker &mp, ThreadSafeNodeVisits &shared_visits,
 }
 #endif // MCTS_PRINT_STAT
 
-void mcts_worker(Position *pos, int max_iterations,
-                 ThreadSafeNodeVisits &shared_visits)
+// Run iterations on the shared tree until the budget of the search is used
+// up or the time is over. pos is the root position, which every iteration
+// leaves as it found it.
+void mcts_worker(Tree &tree, Position &pos)
 {
-    Sanmill::Stack<Position> ss;
-
-    Node *root = new Node(new Position(*pos), MOVE_NONE, nullptr, 0);
+    std::vector<Node *> path;
+    std::vector<Color> sides;
+    std::deque<StateInfo> states;
 
     int iteration = 0;
 
-#ifdef MCTS_ALPHA_BETA
-    Move bestMove {MOVE_NONE};
-    const int max_alpha_beta_depth = 15; // set a max depth according to your
-                                         // needs
-#endif                                   // MCTS_ALPHA_BETA
-
     const int check_time_mask = CHECK_TIME_FREQUENCY - 1;
 
-    // Add time limit (no limit if gameOptions.getMoveTime() returns 0)
-    const auto start_time = std::chrono::steady_clock::now();
-    const auto move_time = gameOptions.getMoveTime();
-    const auto time_limit = move_time > 0 ?
-                                std::chrono::seconds(move_time) :
-                                std::chrono::steady_clock::time_point::max() -
-                                    std::chrono::steady_clock::now();
-
-    while (iteration < max_iterations) {
-        Node *node = select(root, EXPLORATION_PARAMETER);
-#ifdef MCTS_ALPHA_BETA
-        if (should_use_alpha_beta(node)) { // Check if alpha-beta search should
-                                           // be used
-            Value value = qsearch(pos, ss, node->alpha_beta_depth,
-                                  node->alpha_beta_depth, -VALUE_INFINITE,
-                                  VALUE_INFINITE, bestMove);
-            node->num_visits++;
-            if (value > 0) {
-                node->num_wins++;
+    // Add the virtual loss to the node and make its move
+    const auto descend = [&](Node *node) {
+        node->visits.fetch_add(VIRTUAL_LOSS, std::memory_order_relaxed);
+        if (!path.empty()) {
+            if (states.size() < path.size()) {
+                states.emplace_back();
             }
-            if (node->alpha_beta_depth < max_alpha_beta_depth) {
-                node->alpha_beta_depth++; // Increase the depth for the next
-                                          // alpha-beta search
+            pos.do_move(node->move, states[path.size() - 1]);
+        }
+        path.push_back(node);
+        sides.push_back(pos.side_to_move());
+    };
+
+    while (!tree.stop.load(std::memory_order_relaxed) &&
+           !Threads.stop.load(std::memory_order_relaxed) &&
+           tree.root.winner.load(std::memory_order_relaxed) == NOCOLOR &&
+           tree.iterations.fetch_add(1, std::memory_order_relaxed) <
+               tree.max_iterations) {
+        path.clear();
+        sides.clear();
+        descend(&tree.root);
+
+        // Select the next node to expand. Proven nodes are not searched
+        // further, and the moves proven to lose are skipped.
+        Node *node = &tree.root;
+        Color winner = NOCOLOR;
+        while ((winner = node->winner.load(std::memory_order_relaxed)) ==
+                   NOCOLOR &&
+               node->state.load(std::memory_order_acquire) == Node::EXPANDED &&
+               node->child_count > 0) {
+            Node *child = best_uct_child_tuned(node, sides.back(),
+                                               EXPLORATION_PARAMETER);
+            if (child == nullptr) {
+                winner = prove(node, sides.back());
+                break;
             }
-        } else {
+            node = child;
+            descend(node);
+        }
+
+        if (winner == NOCOLOR) {
+            Value value;
+
+#ifdef MCTS_ALPHA_BETA
+            // Check if alpha-beta search should be used
+            if (should_use_alpha_beta(node)) {
+                Move bestMove {MOVE_NONE};
+                Depth depth = node->alpha_beta_depth;
+                value = qsearch(&pos, depth, depth, -VALUE_INFINITE,
+                                VALUE_INFINITE, bestMove);
+                if (depth < 15) { // set a max depth according to your needs
+                    // Increase the depth for the next alpha-beta search
+                    node->alpha_beta_depth.compare_exchange_strong(depth,
+                                                                   depth + 1);
+                }
+            } else {
 #endif // MCTS_ALPHA_BETA
-            Node *expanded_node = expand(node);
-            bool win = simulate(expanded_node, ss);
-            backpropagate(expanded_node, win);
+                if (Node *child = expand(tree, node, pos)) {
+                    descend(child);
+                }
+
+                value = simulate(pos);
 #ifdef MCTS_ALPHA_BETA
-        }
+            }
 #endif // MCTS_ALPHA_BETA
 
-        iteration++;
+            winner = value > 0 ? sides.back() : ~sides.back();
 
-        if ((iteration & check_time_mask) == 0) {
-            auto current_time = std::chrono::steady_clock::now();
-            if (move_time > 0 && current_time - start_time >= time_limit) {
-                break;
+            if (is_proven(value)) {
+                set_winner(path.back(), winner);
             }
         }
-    }
 
-    for (Node *child : root->children) {
-        shared_visits.increment_visits(child->move_index, child->num_visits);
-        shared_visits.increment_wins(child->move_index, child->num_wins);
+        for (size_t i = path.size() - 1; i > 0; i--) {
+            pos.undo_move(path[i]->move);
+        }
+
+        // The values of a stopped search cannot be trusted
+        if (Threads.stop.load(std::memory_order_relaxed)) {
+            break;
+        }
+
+        backpropagate(path, sides, winner);
+
+        if (path.back()->winner.load(std::memory_order_relaxed) != NOCOLOR) {
+            backup_proof(path, sides);
+        }
+
+        iteration++;
+
+        if ((iteration & check_time_mask) == 0 && tree.move_time > 0 &&
+            std::chrono::steady_clock::now() - tree.start_time >=
+                std::chrono::seconds(tree.move_time)) {
+            tree.stop = true;
+        }
     }
+}
 
-    delete_tree(root);
+// Grow the tree of the running search from a helper thread of the pool
+void mcts_helper(Position *pos)
+{
+    if (currentTree != nullptr) {
+        mcts_worker(*currentTree, *pos);
+    }
 }
 
-// Perform Monte Carlo Tree Search to find the best move and its value
+// Perform Monte Carlo Tree Search to find the best move and its value. The
+// main thread of the pool shares the tree with the helper threads, which
+// search on their own copies of the root position.
 Value monte_carlo_tree_search(Position *pos, Move &bestMove)
 {
+    std::unique_ptr<Tree> reused = reuse_tree(*pos);
+    Tree &tree = *reused;
+
     // Adjust these values according to your needs
     int max_iterations = gameOptions.getSkillLevel() *
                          ITERATIONS_PER_SKILL_LEVEL;
@@ -362,40 +899,71 @@ Value monte_carlo_tree_search(Position *pos, Move &bestMove)
         max_iterations = 1;
     }
 
-    ThreadSafeNodeVisits shared_visits(MAX_MOVES);
+    // The iterations of the reused subtree count against the budget, but the
+    // root must be expanded at least
+    tree.max_iterations = std::max(
+        max_iterations - static_cast<int>(tree.root.visits.load()),
+        tree.root.state.load() == Node::EXPANDED ? 0 : 1);
 
-    int num_threads = std::thread::hardware_concurrency();
-    if (num_threads == 0) {
-        num_threads = 1;
+    // Add time limit (no limit if gameOptions.getMoveTime() returns 0)
+    tree.start_time = std::chrono::steady_clock::now();
+    tree.move_time = gameOptions.getMoveTime();
+
+    // The tree is shared with the helper threads of the pool when there are
+    // some. Otherwise, with the default single thread or from the AI threads
+    // of the Qt GUI, it is grown by one thread per core as MCTS always did.
+    // The budget is shared either way.
+    const bool shared = Threads.size() > 1 &&
+                        pos->this_thread() == Threads.front();
+    std::vector<Position> copies;
+    std::vector<std::thread> threads;
+
+    if (shared) {
+        currentTree = &tree;
+        Threads.start_searching();
+    } else {
+        const unsigned cores = std::max(std::thread::hardware_concurrency(),
+                                        1u);
+        copies.assign(cores - 1, *pos);
+        for (Position &copy : copies) {
+            threads.emplace_back([&tree, &copy] { mcts_worker(tree, copy); });
+        }
     }
-    std::vector<std::thread> threads(num_threads);
 
-    for (int i = 0; i < num_threads; ++i) {
-        threads[i] = std::thread(mcts_worker, pos, max_iterations / num_threads,
-                                 std::ref(shared_visits));
-    }
+    mcts_worker(tree, *pos);
 
-    for (auto &t : threads) {
-        if (t.joinable()) {
-            t.join();
-        }
+    if (shared) {
+        Threads.wait_for_search_finished();
+        currentTree = nullptr;
     }
 
-    MovePicker mp(*pos);
-    mp.next_move();
-
-    int best_move_index = 0;
-    uint32_t max_visits = 0;
+    for (std::thread &t : threads) {
+        t.join();
+    }
 
-    for (int i = 0; i < mp.move_count(); ++i) {
-        uint32_t visits = shared_visits.visits(i);
-        if (visits > max_visits) {
-            max_visits = visits;
-            best_move_index = i;
+    // Play a move proven to win if there is one, else the most visited move
+    // among those not proven to lose
+    const Color us = pos->side_to_move();
+    const auto rank = [us](const Node *node) {
+        const Color winner = node->winner;
+        return winner == us ? 2 : winner == ~us ? 0 : 1;
+    };
+    const Node *best = nullptr;
+
+    for (int i = 0; i < tree.root.child_count; ++i) {
+        const Node *child = &tree.root.children[i];
+        if (best == nullptr || rank(child) > rank(best) ||
+            (rank(child) == rank(best) && child->visits > best->visits)) {
+            best = child;
         }
     }
 
-    bestMove = mp.moves[best_move_index].move;
+    if (best != nullptr) {
+        bestMove = best->move;
+    } else {
+        MovePicker mp(*pos);
+        bestMove = mp.next_move();
+    }
 
     Value best_value = (pos->piece_on_board_count(pos->sideToMove) +
                         pos->piece_in_hand_count(pos->sideToMove) -
@@ -403,16 +971,24 @@ Value monte_carlo_tree_search(Position *pos, Move &bestMove)
                         pos->piece_in_hand_count(~pos->sideToMove)) *
                        VALUE_EACH_PIECE;
 
+    // The result of a solved root is exact
+    if (tree.root.winner == us) {
+        best_value = VALUE_MATE;
+    } else if (tree.root.winner == ~us) {
+        best_value = -VALUE_MATE;
+    }
+
 #ifdef MCTS_PRINT_STAT
-    double win_score = static_cast<double>(
-                           shared_visits.wins(best_move_index)) /
-                       shared_visits.visits(best_move_index);
+    double win_score = best != nullptr ? best->win_score() : 0.0;
     // Value best_value = static_cast<Value>(win_score * 100.0 - 50.0);
-    // double win_score = static_cast<double>(max_visits) /
-    //                    (max_iterations / num_threads);
 
-    print_stats(mp, shared_visits, bestMove, best_value, win_score);
+    print_stats(tree.root, bestMove, best_value, win_score);
 #endif // MCTS_PRINT_STAT
 
+    // A stopped search leaves virtual losses in the tree
+    if (!Threads.stop.load(std::memory_order_relaxed)) {
+        keptTree = std::move(reused);
+    }
+
     return best_value;
 }
@@ -69,6 +69,20 @@ static constexpr int CHECK_TIME_FREQUENCY = 128;
 // Iterations per skill level
 static constexpr int ITERATIONS_PER_SKILL_LEVEL = 2048;
 
+// The threads share one tree. A thread counts VIRTUAL_LOSS visits without a
+// win on each node of its path when it selects it, and takes back all but one
+// of them with the result of the simulation, so that the other threads are
+// steered towards other paths in the meantime.
+static constexpr int VIRTUAL_LOSS = 3;
+
+// The tree of a search is kept for the next one, which starts from the node
+// of its root position if it is found in the first REUSE_PLIES plies. A turn
+// takes two plies when a mill is closed, one to move and one to remove.
+static constexpr int REUSE_PLIES = 4;
+
 Value monte_carlo_tree_search(Position *pos, Move &bestMove);
 
+// Entry of the helper threads of the pool into the running search
+void mcts_helper(Position *pos);
+
 #endif // MCTS_H
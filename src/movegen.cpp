@@ -15,38 +15,71 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "movegen.h"
+#include "bitboard.h"
 #include "mills.h"
 #include "position.h"
 
+namespace {
+
+// Return the pieces of c which are in a mill
+Bitboard mill_pieces(const Position &pos, Color c)
+{
+    const Bitboard ours = pos.byColorBB[c];
+    Bitboard mills = 0;
+
+    for (Square s = SQ_BEGIN; s < SQ_END; ++s) {
+        if (!(ours & s)) {
+            continue;
+        }
+
+        const Bitboard *mt = Position::millTableBB[s];
+
+        if ((ours & mt[LD_HORIZONTAL]) == mt[LD_HORIZONTAL] ||
+            (ours & mt[LD_VERTICAL]) == mt[LD_VERTICAL] ||
+            (ours & mt[LD_SLASH]) == mt[LD_SLASH]) {
+            mills |= s;
+        }
+    }
+
+    return mills;
+}
+
+} // namespace
+
 /// generate<MOVE> generates all moves.
 /// Returns a pointer to the end of the move moves.
 template <>
-ExtMove *generate<MOVE>(Position &pos, ExtMove *moveList)
+ExtMove *generate<MOVE>(const Position &pos, ExtMove *moveList)
 {
     ExtMove *cur = moveList;
 
+    const Color us = pos.side_to_move();
+    const Bitboard ours = pos.byColorBB[us];
+    const Bitboard empty = ~pos.byTypeBB[ALL_PIECES];
+    const bool flying = rule.mayFly &&
+                        pos.piece_on_board_count(us) <= rule.flyPieceCount;
+
     // move piece that location weak first
     for (auto i = SQUARE_NB - 1; i >= 0; i--) {
         const Square from = MoveList<LEGAL>::movePriorityList[i];
 
-        if (!pos.select_piece(from)) {
+        if (!(ours & from)) {
             continue;
         }
 
-        if (rule.mayFly && pos.piece_on_board_count(pos.side_to_move()) <=
-                               rule.flyPieceCount) {
+        if (flying) {
             // piece count < 3 or 4 and allow fly, if is empty point, that's ok,
             // do not need in move list
             for (Square to = SQ_BEGIN; to < SQ_END; ++to) {
-                if (!pos.get_board()[to]) {
+                if (empty & to) {
                     *cur++ = make_move(from, to);
                 }
             }
-        } else {
+        } else if (MoveList<LEGAL>::adjacentSquaresBB[from] & empty) {
             for (auto direction = MD_BEGIN; direction < MD_NB; ++direction) {
                 const Square to =
                     MoveList<LEGAL>::adjacentSquares[from][direction];
-                if (to && !pos.get_board()[to]) {
+                if (to && (empty & to)) {
                     *cur++ = make_move(from, to);
                 }
             }
@@ -59,12 +92,14 @@ ExtMove *generate<MOVE>(Position &pos, ExtMove *moveList)
 /// generate<PLACE> generates all places.
 /// Returns a pointer to the end of the move list.
 template <>
-ExtMove *generate<PLACE>(Position &pos, ExtMove *moveList)
+ExtMove *generate<PLACE>(const Position &pos, ExtMove *moveList)
 {
     ExtMove *cur = moveList;
 
+    const Bitboard empty = ~pos.byTypeBB[ALL_PIECES];
+
     for (auto s : MoveList<LEGAL>::movePriorityList) {
-        if (!pos.get_board()[s]) {
+        if (empty & s) {
             *cur++ = static_cast<Move>(s);
         }
     }
@@ -75,44 +110,39 @@ ExtMove *generate<PLACE>(Position &pos, ExtMove *moveList)
 /// generate<REMOVE> generates all removes.
 /// Returns a pointer to the end of the move moves.
 template <>
-ExtMove *generate<REMOVE>(Position &pos, ExtMove *moveList)
+ExtMove *generate<REMOVE>(const Position &pos, ExtMove *moveList)
 {
     const Color us = pos.side_to_move();
     const Color them = ~us;
+    const Bitboard theirs = pos.byColorBB[them];
 
     ExtMove *cur = moveList;
 
+    // The pieces which may be removed: in a stalemate those next to ours,
+    // else those out of mills unless all of them are in mills
+    Bitboard removable;
+
     if (pos.is_stalemate_removal()) {
-        for (auto i = SQUARE_NB - 1; i >= 0; i--) {
-            Square s = MoveList<LEGAL>::movePriorityList[i];
-            if (pos.get_board()[s] & make_piece(them)) {
-                if (pos.is_adjacent_to(s, us) == true) {
-                    *cur++ = static_cast<Move>(-s);
-                }
+        removable = 0;
+        for (Square s = SQ_BEGIN; s < SQ_END; ++s) {
+            if ((theirs & s) &&
+                (MoveList<LEGAL>::adjacentSquaresBB[s] & pos.byColorBB[us])) {
+                removable |= s;
             }
         }
-
-        return cur;
-    }
-
-    if (pos.is_all_in_mills(them)) {
-        for (auto i = SQUARE_NB - 1; i >= 0; i--) {
-            Square s = MoveList<LEGAL>::movePriorityList[i];
-            if (pos.get_board()[s] & make_piece(them)) {
-                *cur++ = static_cast<Move>(-s);
-            }
+    } else if (rule.mayRemoveFromMillsAlways) {
+        removable = theirs;
+    } else {
+        removable = theirs & ~mill_pieces(pos, them);
+        if (!removable) {
+            removable = theirs;
         }
-        return cur;
     }
 
-    // not is all in mills
     for (auto i = SQUARE_NB - 1; i >= 0; i--) {
         const Square s = MoveList<LEGAL>::movePriorityList[i];
-        if (pos.get_board()[s] & make_piece(them)) {
-            if (rule.mayRemoveFromMillsAlways ||
-                !pos.potential_mills_count(s, NOBODY)) {
-                *cur++ = static_cast<Move>(-s);
-            }
+        if (removable & s) {
+            *cur++ = static_cast<Move>(-s);
         }
     }
 
@@ -122,7 +152,7 @@ ExtMove *generate<REMOVE>(Position &pos, ExtMove *moveList)
 /// generate<LEGAL> generates all the legal moves in the given position
 
 template <>
-ExtMove *generate<LEGAL>(Position &pos, ExtMove *moveList)
+ExtMove *generate<LEGAL>(const Position &pos, ExtMove *moveList)
 {
     ExtMove *cur = moveList;
 
@@ -46,7 +46,7 @@ inline bool operator<(const ExtMove &f, const ExtMove &s) noexcept
 }
 
 template <GenType>
-ExtMove *generate(Position &pos, ExtMove *moveList);
+ExtMove *generate(const Position &pos, ExtMove *moveList);
 
 /// The MoveList struct is a simple wrapper around generate(). It sometimes
 /// comes in handy to use this class instead of the low level generate()
@@ -54,7 +54,7 @@ ExtMove *generate(Position &pos, ExtMove *moveList);
 template <GenType T>
 struct MoveList
 {
-    explicit MoveList(Position &pos)
+    explicit MoveList(const Position &pos)
         : last(generate<T>(pos, moveList))
     { }
 
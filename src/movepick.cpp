@@ -16,6 +16,22 @@
 
 #include "movepick.h"
 #include "option.h"
+#include "thread.h"
+
+namespace {
+
+// The search feedback orders moves of the same static rating. Killers and the
+// counter move come first, then the other moves by their history score, which
+// lies within [-8192, 8192].
+constexpr int RatingScale = 65536;
+
+enum FeedbackBonus {
+    CounterMoveBonus = 16384,
+    Killer1Bonus = 20480,
+    Killer0Bonus = 24576
+};
+
+} // namespace
 
 // partial_insertion_sort() sorts moves in descending order up to and including
 // a given limit. The order of moves smaller than the limit is left unspecified.
@@ -38,10 +54,22 @@ MovePicker::MovePicker(Position &p) noexcept
     : pos(p)
 { }
 
-/// MovePicker::score() assigns a numerical value to each move in a list, used
-/// for sorting.
+/// MovePicker constructor for the alpha-beta search, which puts the TT move
+/// first and orders the others by the statistics the searching thread has
+/// gathered so far. The statistics are null for a search without a thread.
+MovePicker::MovePicker(Position &p, Move ttm, const ButterflyHistory *mh,
+                       const Move *km, Move cm) noexcept
+    : pos(p)
+    , mainHistory(mh)
+    , killers(km)
+    , counterMove(cm)
+    , ttMove(ttm)
+{ }
+
+/// MovePicker::score() assigns a numerical value to each move in a list from
+/// first on, used for sorting.
 template <GenType Type>
-void MovePicker::score()
+void MovePicker::score(ExtMove *first)
 {
     int theirMillsCount;
     int ourPieceCount = 0;
@@ -49,7 +77,12 @@ void MovePicker::score()
     int markedCount = 0;
     int emptyCount = 0;
 
-    for (cur = moves; cur->move != MOVE_NONE; cur++) {
+    // Helper threads of the Lazy SMP search break ties between equally rated
+    // moves in their own order, so that they do not all walk the same tree.
+    const Thread *th = pos.this_thread();
+    const auto perturb = static_cast<uint32_t>(th != nullptr ? th->idx : 0);
+
+    for (cur = first; cur->move != MOVE_NONE; cur++) {
         Move m = cur->move;
 
         const Square to = to_sq(m);
@@ -143,6 +176,28 @@ void MovePicker::score()
             cur->value += emptyCount;
         }
 #endif // !SORT_MOVE_WITHOUT_HUMAN_KNOWLEDGE
+
+        if (mainHistory != nullptr) {
+            int feedback = (*mainHistory)[pos.side_to_move()]
+                                         [history_from(m)][to];
+
+            if (m == killers[0]) {
+                feedback = Killer0Bonus;
+            } else if (m == killers[1]) {
+                feedback = Killer1Bonus;
+            } else if (m == counterMove) {
+                feedback = CounterMoveBonus;
+            }
+
+            cur->value = cur->value * RatingScale + feedback;
+        }
+
+        if (perturb) {
+            cur->value = cur->value * 4 +
+                         static_cast<int>((static_cast<uint32_t>(m) * perturb *
+                                           0x9E3779B1U) >>
+                                          30);
+        }
     }
 }
 
@@ -155,8 +210,33 @@ Move MovePicker::next_move()
     endMoves = generate<LEGAL>(pos, moves);
     moveCount = static_cast<int>(endMoves - moves);
 
-    score<LEGAL>();
+    // A TT move found among the legal moves goes first, and the others are
+    // only scored once it has failed to produce a cutoff
+    if (ttMove != MOVE_NONE) {
+        ExtMove *tt = std::find(moves, endMoves, ttMove);
+
+        if (tt != endMoves) {
+            std::swap(*moves, *tt);
+            remainingUnsorted = true;
+            return *moves;
+        }
+    }
+
+    score<LEGAL>(moves);
     partial_insertion_sort(moves, endMoves, INT_MIN);
 
     return *moves;
 }
+
+/// MovePicker::score_remaining() scores and sorts the moves behind the TT
+/// move. It must be called before the second move is searched.
+void MovePicker::score_remaining()
+{
+    if (!remainingUnsorted) {
+        return;
+    }
+
+    remainingUnsorted = false;
+    score<LEGAL>(moves + 1);
+    partial_insertion_sort(moves + 1, endMoves, INT_MIN);
+}
@@ -17,7 +17,11 @@
 #ifndef MOVEPICK_H_INCLUDED
 #define MOVEPICK_H_INCLUDED
 
+#include <algorithm>
 #include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
 #include <limits>
 #include <type_traits>
 
@@ -30,6 +34,78 @@ struct ExtMove;
 
 void partial_insertion_sort(ExtMove *begin, const ExtMove *end, int limit);
 
+/// StatsEntry stores the stat table value. It is usually a number but could
+/// be a move or even a nested history. We use a class instead of naked value
+/// to directly call history update operator<<() on the entry so to use stats
+/// tables at caller sites as simple multi-dim arrays.
+template <typename T, int D>
+class StatsEntry
+{
+    T entry;
+
+public:
+    void operator=(const T &v) { entry = v; }
+    T *operator&() { return &entry; }
+    T *operator->() { return &entry; }
+    operator const T &() const { return entry; }
+
+    void operator<<(int bonus)
+    {
+        assert(abs(bonus) <= D); // Ensure range is [-D, D]
+        static_assert(D <= std::numeric_limits<T>::max(), "D overflows T");
+
+        entry += bonus - entry * abs(bonus) / D;
+
+        assert(abs(entry) <= D);
+    }
+};
+
+/// Stats is a generic N-dimensional array used to store various statistics.
+/// The first template parameter T is the base type of the array, the second
+/// template parameter D limits the range of updates in [-D, D] when we update
+/// values with the << operator, while the last parameters (Size and Sizes)
+/// encode the dimensions of the array.
+template <typename T, int D, int Size, int... Sizes>
+struct Stats : public std::array<Stats<T, D, Sizes...>, Size>
+{
+    typedef Stats<T, D, Size, Sizes...> stats;
+
+    void fill(const T &v)
+    {
+        // For standard-layout 'this' points to first struct member
+        assert(std::is_standard_layout<stats>::value);
+
+        typedef StatsEntry<T, D> entry;
+        entry *p = reinterpret_cast<entry *>(this);
+        std::fill(p, p + sizeof(*this) / sizeof(entry), v);
+    }
+};
+
+template <typename T, int D, int Size>
+struct Stats<T, D, Size> : public std::array<StatsEntry<T, D>, Size>
+{ };
+
+/// In stats table, D=0 means that the template parameter is not used
+enum StatsParams { NOT_USED = 0 };
+
+/// ButterflyHistory records how often the moves of each side have caused a
+/// beta cutoff during the current search. It is indexed by color and by the
+/// from and to squares of the move, see www.chessprogramming.org/Butterfly_Boards
+typedef Stats<int16_t, 8192, COLOR_NB, SQUARE_EXT_NB, SQUARE_EXT_NB>
+    ButterflyHistory;
+
+/// CounterMoveHistory stores the move which refuted a move, indexed like
+/// ButterflyHistory by the from and to squares of the refuted move
+typedef Stats<Move, NOT_USED, SQUARE_EXT_NB, SQUARE_EXT_NB> CounterMoveHistory;
+
+/// history_from() returns the from square under which a move is recorded in
+/// the stats tables. A place has no origin and uses SQ_NONE, while a removal
+/// uses its own square, which no other move can.
+constexpr Square history_from(Move m)
+{
+    return type_of(m) == MOVETYPE_REMOVE ? to_sq(m) : from_sq(m);
+}
+
 /// MovePicker class is used to pick one pseudo legal move at a time from the
 /// current position. The most important method is next_move(), which returns a
 /// new pseudo legal move each time it is called, until there are no moves left,
@@ -42,23 +118,30 @@ public:
     MovePicker(const MovePicker &) = delete;
     MovePicker &operator=(const MovePicker &) = delete;
     explicit MovePicker(Position &p) noexcept;
+    MovePicker(Position &p, Move ttm, const ButterflyHistory *mh,
+               const Move *km, Move cm) noexcept;
 
     Move next_move();
+    void score_remaining();
 
     template <GenType>
-    void score();
+    void score(ExtMove *first);
 
     ExtMove *begin() const noexcept { return cur; }
 
     ExtMove *end() const noexcept { return endMoves; }
 
     Position &pos;
+    const ButterflyHistory *mainHistory {nullptr};
+    const Move *killers {nullptr};
+    Move counterMove {MOVE_NONE};
     Move ttMove {MOVE_NONE};
     ExtMove *cur {nullptr};
     ExtMove *endMoves {nullptr};
     ExtMove moves[MAX_MOVES] {{MOVE_NONE, 0}};
 
     int moveCount {0};
+    bool remainingUnsorted {false};
 
     int move_count() const noexcept { return moveCount; }
 };
@@ -215,6 +215,16 @@ public:
 
     int getAlgorithm() const noexcept { return algorithm; }
 
+    // MCTS simulates with random playouts instead of a shallow search, where
+    // the playouts support the rule
+
+    void setMctsRandomPlayout(bool enabled) noexcept
+    {
+        mctsRandomPlayout = enabled;
+    }
+
+    bool getMctsRandomPlayout() const noexcept { return mctsRandomPlayout; }
+
     // Perfect Database
 
     void setUsePerfectDatabase(bool enabled) noexcept
@@ -234,6 +244,54 @@ public:
         return perfectDatabasePath;
     }
 
+    // Memory for the resident hash objects of the perfect database, in MB. 0
+    // keeps only the one in use.
+    void setPerfectDatabaseMemory(int mb) noexcept
+    {
+        perfectDatabaseMemory = mb;
+    }
+
+    int getPerfectDatabaseMemory() const noexcept
+    {
+        return perfectDatabaseMemory;
+    }
+
+    // Read the whole sector file in when a sector of the perfect database is
+    // loaded
+    void setPerfectDatabasePrefetch(bool enabled) noexcept
+    {
+        perfectDatabasePrefetch = enabled;
+    }
+
+    bool getPerfectDatabasePrefetch() const noexcept
+    {
+        return perfectDatabasePrefetch;
+    }
+
+    // The search probes the perfect database at the nodes with at least this
+    // remaining depth...
+    void setPerfectDatabaseProbeDepth(int depth) noexcept
+    {
+        perfectDatabaseProbeDepth = depth;
+    }
+
+    int getPerfectDatabaseProbeDepth() const noexcept
+    {
+        return perfectDatabaseProbeDepth;
+    }
+
+    // ...and at most this many pieces, on the board and in hand. 0 disables
+    // the probes of the search, leaving only the one at the root.
+    void setPerfectDatabaseProbeLimit(int count) noexcept
+    {
+        perfectDatabaseProbeLimit = count;
+    }
+
+    int getPerfectDatabaseProbeLimit() const noexcept
+    {
+        return perfectDatabaseProbeLimit;
+    }
+
     // DrawOnHumanExperience
 
     void setDrawOnHumanExperience(bool enabled) noexcept
@@ -275,7 +333,12 @@ private:
     bool learnEndgame {false};
 #endif
     int algorithm {2};
+    bool mctsRandomPlayout {false};
     bool usePerfectDatabase {false};
+    int perfectDatabaseMemory {1024};
+    bool perfectDatabasePrefetch {false};
+    int perfectDatabaseProbeDepth {1};
+    int perfectDatabaseProbeLimit {24};
     bool IDSEnabled {false};
     bool depthExtension {true};
     bool openingBook {false};
@@ -14,7 +14,9 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
 #include <condition_variable>
+#include <iostream>
 #include <mutex>
 #include <sstream>
 #include <stdexcept>
@@ -25,6 +27,10 @@
 #include "option.h"
 #include "perfect_adaptor.h"
 #include "perfect_api.h"
+#ifndef FLUTTER_UI
+#include "perfect_solver.h"
+#include "perfect_verifier.h"
+#endif
 #include "perfect_wrappers.h"
 #include "position.h"
 
@@ -113,6 +119,8 @@ int perfect_exit()
     malom_remove_move = MOVE_NONE;
     malom_remove_value = VALUE_UNKNOWN;
 
+    MalomSolutionAccess::deinitializeIfNeeded();
+
     return 0;
 }
 
@@ -121,6 +129,82 @@ int perfect_reset()
     return perfect_init();
 }
 
+#ifndef FLUTTER_UI
+// The database holds Nine Men's Morris, Lasker Morris and Morabaraba as Malom
+// plays them. Returns why the current rule is none of them, or nullptr.
+static const char *unsupported_rule()
+{
+    if (rule.pieceCount != 9 && rule.pieceCount != 10 &&
+        rule.pieceCount != 12) {
+        return "only 9, 10 and 12 pieces are supported";
+    }
+
+    if (rule.hasDiagonalLines != (rule.pieceCount == 12)) {
+        return "diagonal lines go with 12 pieces only";
+    }
+
+    if (rule.mayMoveInPlacingPhase != (rule.pieceCount == 10)) {
+        return "moving in the placing phase goes with 10 pieces only";
+    }
+
+    if (!rule.mayFly || rule.flyPieceCount != 3 ||
+        rule.piecesAtLeastCount != 3) {
+        return "pieces must fly when three are left";
+    }
+
+    if (rule.millFormationActionInPlacingPhase !=
+            MillFormationActionInPlacingPhase::removeOpponentsPieceFromBoard ||
+        rule.mayRemoveMultiple || rule.mayRemoveFromMillsAlways) {
+        return "a mill must remove one piece not in a mill, if there is one";
+    }
+
+    if (rule.isDefenderMoveFirst) {
+        return "the first player must move first in the moving phase";
+    }
+
+    if (rule.boardFullAction != BoardFullAction::firstPlayerLose &&
+        rule.boardFullAction != BoardFullAction::agreeToDraw) {
+        return "a full board must lose or draw";
+    }
+
+    if (rule.stalemateAction != StalemateAction::endWithStalemateLoss) {
+        return "a player without moves must lose";
+    }
+
+    return nullptr;
+}
+
+bool perfect_solve(const std::string &path, int threads)
+{
+    if (const char *reason = unsupported_rule()) {
+        std::cerr << "Failed to solve " << rule.name << ": " << reason
+                  << std::endl;
+        return false;
+    }
+
+    // The solver shares the sector tables with the player, which must not be
+    // using them meanwhile
+    perfect_exit();
+    perfect_init();
+
+    return solve_database(path, threads);
+}
+
+bool perfect_verify(const std::string &path, int threads)
+{
+    if (const char *reason = unsupported_rule()) {
+        std::cerr << "Failed to verify " << rule.name << ": " << reason
+                  << std::endl;
+        return false;
+    }
+
+    perfect_exit();
+    perfect_init();
+
+    return verify_database(path, threads);
+}
+#endif
+
 Square from_perfect_sq(uint32_t sq)
 {
     constexpr Square map[] = {SQ_30, SQ_31, SQ_24, SQ_25, SQ_26, SQ_27, SQ_28,
@@ -229,6 +313,19 @@ std::vector<Move> convertBitboardMove(int whiteBitboard, int blackBitboard,
     return moves;
 }
 
+static void perfect_bitboards(const Position *pos, int &whiteBitboard,
+                              int &blackBitboard)
+{
+    for (int i = 0; i < 24; i++) {
+        auto c = color_of(pos->board[from_perfect_sq(i)]);
+        if (c == WHITE) {
+            whiteBitboard |= 1 << i;
+        } else if (c == BLACK) {
+            blackBitboard |= 1 << i;
+        }
+    }
+}
+
 Value perfect_search(const Position *pos, Move &move)
 {
     Value value = VALUE_UNKNOWN;
@@ -260,14 +357,7 @@ Value perfect_search(const Position *pos, Move &move)
     // The black stones on the board.
     int blackBitboard = 0;
 
-    for (int i = 0; i < 24; i++) {
-        auto c = color_of(pos->board[from_perfect_sq(i)]);
-        if (c == WHITE) {
-            whiteBitboard |= 1 << i;
-        } else if (c == BLACK) {
-            blackBitboard |= 1 << i;
-        }
-    }
+    perfect_bitboards(pos, whiteBitboard, blackBitboard);
 
     // The number of stones the white player can still place on the board.
     int whiteStonesToPlace = pos->piece_in_hand_count(WHITE);
@@ -322,4 +412,38 @@ Value perfect_search(const Position *pos, Move &move)
     return value;
 }
 
+bool perfect_probe(const Position *pos, Depth depth, Value &value)
+{
+    // The database takes one stone per mill
+    const int toRemove = pos->piece_to_remove_count(pos->side_to_move());
+    if (toRemove != 0 && toRemove != 1) {
+        return false;
+    }
+
+    int whiteBitboard = 0;
+    int blackBitboard = 0;
+    perfect_bitboards(pos, whiteBitboard, blackBitboard);
+
+    int outcome, steps;
+    if (!MalomSolutionAccess::probe(whiteBitboard, blackBitboard,
+                                    pos->piece_in_hand_count(WHITE),
+                                    pos->piece_in_hand_count(BLACK),
+                                    pos->side_to_move() == WHITE ? 0 : 1,
+                                    toRemove == 1, outcome, steps)) {
+        return false;
+    }
+
+    if (outcome == 0) {
+        value = VALUE_DRAW;
+    } else {
+        // Like the end of the game at a leaf, which gets the remaining depth
+        // on top of VALUE_MATE
+        const int quickness = std::max(depth - steps, 0);
+        value = static_cast<Value>(outcome > 0 ? VALUE_MATE + quickness :
+                                                 -VALUE_MATE - quickness);
+    }
+
+    return true;
+}
+
 #endif // GABOR_MALOM_PERFECT_AI
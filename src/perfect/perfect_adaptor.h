@@ -17,6 +17,8 @@
 #ifndef PERFECT_PERFECT_H_INCLUDED
 #define PERFECT_PERFECT_H_INCLUDED
 
+#include <string>
+
 #include "position.h"
 #include "types.h"
 
@@ -28,4 +30,20 @@ int to_perfect_sq(Square sq);
 
 Value perfect_search(const Position *pos, Move &bestMove);
 
+// The exact value of pos for the search, if the perfect database has it in
+// memory. Returns false without waiting for the disk otherwise.
+bool perfect_probe(const Position *pos, Depth depth, Value &value);
+
+#ifndef FLUTTER_UI
+// Generates the perfect database of the current rule in path with the given
+// number of threads, see solve_database(). Returns false on failure, or if
+// the rule is not one the database can hold.
+bool perfect_solve(const std::string &path, int threads);
+
+// Checks the perfect database of the current rule in path with the given
+// number of threads, see verify_database(). Returns false if it is incomplete
+// or has wrong values, or if the rule is not one the database can hold.
+bool perfect_verify(const std::string &path, int threads);
+#endif
+
 #endif // PERFECT_H_INCLUDED
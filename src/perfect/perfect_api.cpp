@@ -33,7 +33,10 @@
 extern int perfect_init();
 
 PerfectPlayer *MalomSolutionAccess::pp = nullptr;
-std::exception *MalomSolutionAccess::lastError = nullptr;
+thread_local std::string MalomSolutionAccess::lastError;
+std::string MalomSolutionAccess::sessionPath;
+int MalomSolutionAccess::sessionPieceCount = 0;
+std::shared_mutex MalomSolutionAccess::sessionMutex;
 
 int MalomSolutionAccess::getBestMove(int whiteBitboard, int blackBitboard,
                                      int whiteStonesToPlace,
@@ -43,6 +46,40 @@ int MalomSolutionAccess::getBestMove(int whiteBitboard, int blackBitboard,
 {
     initializeIfNeeded();
 
+    // Keep the session open until the probes are done
+    std::shared_lock<std::shared_mutex> lock(sessionMutex);
+    if (pp == nullptr) {
+        throw std::runtime_error("The perfect database session was closed");
+    }
+
+    const GameState s = toGameState(whiteBitboard, blackBitboard,
+                                    whiteStonesToPlace, blackStonesToPlace,
+                                    playerToMove, onlyStoneTaking);
+
+    int ret = 0;
+    AdvancedMoveList moves;
+
+    try {
+        pp->goodMoves(s, value, moves);
+        ret = pp->chooseRandom(moves, refMove).toBitBoard();
+    } catch (std::out_of_range &) {
+        throw std::runtime_error("We don't have a database entry for this "
+                                 "position. This can happen either if the "
+                                 "database is corrupted (missing files), or "
+                                 "sometimes when the position is not reachable "
+                                 "from the starting position.");
+    }
+
+    return ret;
+}
+
+GameState MalomSolutionAccess::toGameState(int whiteBitboard,
+                                           int blackBitboard,
+                                           int whiteStonesToPlace,
+                                           int blackStonesToPlace,
+                                           int playerToMove,
+                                           bool onlyStoneTaking)
+{
     GameState s;
 
     const int W = 0;
@@ -95,29 +132,37 @@ int MalomSolutionAccess::getBestMove(int whiteBitboard, int blackBitboard,
 
     s.lastIrrev = 0;
 
-    int ret = 0;
+    return s;
+}
 
-    try {
-        ret = pp->chooseRandom(pp->goodMoves(s, value), refMove).toBitBoard();
-    } catch (std::out_of_range &) {
-        throw std::runtime_error("We don't have a database entry for this "
-                                 "position. This can happen either if the "
-                                 "database is corrupted (missing files), or "
-                                 "sometimes when the position is not reachable "
-                                 "from the starting position.");
+bool MalomSolutionAccess::probe(int whiteBitboard, int blackBitboard,
+                                int whiteStonesToPlace, int blackStonesToPlace,
+                                int playerToMove, bool onlyStoneTaking,
+                                int &outcome, int &steps)
+{
+    // Don't wait for a session being opened or closed
+    std::shared_lock<std::shared_mutex> lock(sessionMutex, std::try_to_lock);
+    if (!lock.owns_lock() || pp == nullptr ||
+        rule.pieceCount != sessionPieceCount) {
+        return false;
     }
 
-    // TODO: Considering the performance-critical aspect of our applications,
-    // it is advised to reconsider the frequent invocation of
-    // deinitializeIfNeeded() within each getBestMove call. Such a practice
-    // necessitates the re-initialization by initializeIfNeeded() at every
-    // function start, leading to significant performance overheads. An
-    // optimized approach for initialization and deinitialization processes
-    // should be explored to mitigate these costs.
-    // https://github.com/ggevay/malom/pull/3#discussion_r1349745071
-    deinitializeIfNeeded();
+    try {
+        const GameState s = toGameState(whiteBitboard, blackBitboard,
+                                        whiteStonesToPlace, blackStonesToPlace,
+                                        playerToMove, onlyStoneTaking);
 
-    return ret;
+        Wrappers::gui_eval_elem2 e;
+        if (!pp->probe(s, e)) {
+            return false;
+        }
+
+        outcome = e.outcome();
+        steps = e.steps();
+        return true;
+    } catch (std::exception &) {
+        return false;
+    }
 }
 
 int MalomSolutionAccess::getBestMoveNoException(
@@ -126,38 +171,62 @@ int MalomSolutionAccess::getBestMoveNoException(
     Value &value, const Move &refMove)
 {
     try {
-        lastError = nullptr;
+        lastError.clear();
         return getBestMove(whiteBitboard, blackBitboard, whiteStonesToPlace,
                            blackStonesToPlace, playerToMove, onlyStoneTaking,
                            value, refMove);
     } catch (std::exception &e) {
-        lastError = &e;
+        lastError = e.what();
         return 0;
     }
 }
 
 std::string MalomSolutionAccess::getLastError()
 {
-    if (lastError == nullptr) {
+    if (lastError.empty()) {
         return "No error";
     }
-    return lastError->what();
+    return lastError;
 }
 
 void MalomSolutionAccess::initializeIfNeeded()
 {
+    Wrappers::WSector::setHashMemoryBudget(
+        static_cast<size_t>(gameOptions.getPerfectDatabaseMemory()) << 20);
+    Wrappers::WSector::setPrefetch(gameOptions.getPerfectDatabasePrefetch());
+
+    const std::string path = gameOptions.getPerfectDatabasePath();
+
+    {
+        std::shared_lock<std::shared_mutex> lock(sessionMutex);
+        if (pp != nullptr && path == sessionPath &&
+            rule.pieceCount == sessionPieceCount) {
+            return;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(sessionMutex);
+
     if (pp != nullptr) {
-        return;
+        if (path == sessionPath && rule.pieceCount == sessionPieceCount) {
+            return;
+        }
+
+        // Another database or rule variant, so start a new session
+        closeSession();
     }
 
     perfect_init();
 
-    sec_val_path = gameOptions.getPerfectDatabasePath();
+    sec_val_path = path;
 
     Rules::initRules();
     setVariantStripped();
 
     if (!Sectors::hasDatabase()) {
+        Sectors::release();
+        Rules::cleanup();
+
         std::string currentPath;
 
 #if defined(__APPLE__)
@@ -176,19 +245,33 @@ void MalomSolutionAccess::initializeIfNeeded()
                                  currentPath + ")");
     }
     pp = new PerfectPlayer();
+
+    sessionPath = path;
+    sessionPieceCount = rule.pieceCount;
 }
 
 void MalomSolutionAccess::deinitializeIfNeeded()
+{
+    std::unique_lock<std::shared_mutex> lock(sessionMutex);
+
+    closeSession();
+}
+
+void MalomSolutionAccess::closeSession()
 {
     if (pp == nullptr) {
         return;
     }
 
-    Rules::cleanup();
-
     delete pp;
 
     pp = nullptr;
+
+    Sectors::release();
+    Rules::cleanup();
+
+    sessionPath.clear();
+    sessionPieceCount = 0;
 }
 
 void MalomSolutionAccess::mustBeBetween(std::string paramName, int value,
@@ -209,6 +292,9 @@ void MalomSolutionAccess::setVariantStripped()
                     sizeof(Rules::stdLaskerMillPos));
         std::memcpy(Rules::invMillPos, Rules::stdLaskerInvMillPos,
                     sizeof(Rules::stdLaskerInvMillPos));
+        std::memcpy(Rules::invMillPosLengths,
+                    Rules::stdLaskerInvMillPosLengths,
+                    sizeof(Rules::stdLaskerInvMillPosLengths));
         std::memcpy(Rules::boardGraph, Rules::stdLaskerBoardGraph,
                     sizeof(Rules::stdLaskerBoardGraph));
         std::memcpy(Rules::aLBoardGraph, Rules::stdLaskerALBoardGraph,
@@ -221,6 +307,9 @@ void MalomSolutionAccess::setVariantStripped()
                     sizeof(Rules::stdLaskerMillPos));
         std::memcpy(Rules::invMillPos, Rules::stdLaskerInvMillPos,
                     sizeof(Rules::stdLaskerInvMillPos));
+        std::memcpy(Rules::invMillPosLengths,
+                    Rules::stdLaskerInvMillPosLengths,
+                    sizeof(Rules::stdLaskerInvMillPosLengths));
         std::memcpy(Rules::boardGraph, Rules::stdLaskerBoardGraph,
                     sizeof(Rules::stdLaskerBoardGraph));
         std::memcpy(Rules::aLBoardGraph, Rules::stdLaskerALBoardGraph,
@@ -233,6 +322,8 @@ void MalomSolutionAccess::setVariantStripped()
                     sizeof(Rules::moraMillPos));
         std::memcpy(Rules::invMillPos, Rules::moraInvMillPos,
                     sizeof(Rules::moraInvMillPos));
+        std::memcpy(Rules::invMillPosLengths, Rules::moraInvMillPosLengths,
+                    sizeof(Rules::moraInvMillPosLengths));
         std::memcpy(Rules::boardGraph, Rules::moraBoardGraph,
                     sizeof(Rules::moraBoardGraph));
         std::memcpy(Rules::aLBoardGraph, Rules::moraALBoardGraph,
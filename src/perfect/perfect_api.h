@@ -24,11 +24,31 @@
 
 #include "perfect_player.h"
 
+#include <shared_mutex>
+
+// The database session stays open across getBestMove() calls. It is only
+// reinitialized when the database path or the rule variant changes, or after
+// deinitializeIfNeeded(). getBestMove() may be called from several threads at
+// once: they share the session, and a new session waits until they are done.
 class MalomSolutionAccess
 {
 private:
     static PerfectPlayer *pp;
-    static std::exception *lastError;
+    static thread_local std::string lastError;
+
+    // What the open session was initialized for
+    static std::string sessionPath;
+    static int sessionPieceCount;
+
+    // Held shared while the session is used, exclusively to open or close it
+    static std::shared_mutex sessionMutex;
+
+    static void closeSession();
+
+    // The position of the parameters of getBestMove(), checked for validity
+    static GameState toGameState(int whiteBitboard, int blackBitboard,
+                                 int whiteStonesToPlace, int blackStonesToPlace,
+                                 int playerToMove, bool onlyStoneTaking);
 
 public:
     static int getBestMove(int whiteBitboard, int blackBitboard,
@@ -44,6 +64,15 @@ public:
 
     static std::string getLastError();
 
+    // The value of a position for the side to move if the open session has it
+    // in memory: outcome is 1 for a win, 0 for a draw and -1 for a loss, and
+    // steps is the distance of a win or a loss. Never opens the session or
+    // reads the disk, so the search can call it at any node.
+    static bool probe(int whiteBitboard, int blackBitboard,
+                      int whiteStonesToPlace, int blackStonesToPlace,
+                      int playerToMove, bool onlyStoneTaking, int &outcome,
+                      int &steps);
+
     static void initializeIfNeeded();
     static void deinitializeIfNeeded();
 
@@ -26,6 +26,21 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdexcept>
 #include <string>
 
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 std::string sec_val_path = ".";
 std::string sec_val_fname = "";
 FILE *f = nullptr;
@@ -41,3 +56,120 @@ void failwith(std::string s)
 {
     throw std::runtime_error(ruleVariantName + ": " + s);
 }
+
+bool MappedFile::open(const std::string &filename)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    // The mapping keeps the file open, so the handle is not needed any more
+    HANDLE m = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (m == nullptr) {
+        return false;
+    }
+
+    void *p = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+    if (p == nullptr) {
+        CloseHandle(m);
+        return false;
+    }
+
+    mapping = m;
+    len = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    void *p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                   MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+
+    len = static_cast<size_t>(st.st_size);
+#endif
+
+    ptr = static_cast<const char *>(p);
+
+    return true;
+}
+
+void MappedFile::advise(Advice advice, size_t offset, size_t n) const
+{
+#ifdef _WIN32
+    // Windows has no such hints for mapped views
+    (void)advice;
+    (void)offset;
+    (void)n;
+#else
+    if (ptr == nullptr || offset >= len) {
+        return;
+    }
+
+    // madvise() wants a page aligned start
+    static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t begin = offset / page * page;
+    const size_t end = n < len - offset ? offset + n : len;
+
+    int a = MADV_NORMAL;
+    switch (advice) {
+    case Advice::Normal:
+        a = MADV_NORMAL;
+        break;
+    case Advice::Random:
+        a = MADV_RANDOM;
+        break;
+    case Advice::Sequential:
+        a = MADV_SEQUENTIAL;
+        break;
+    case Advice::WillNeed:
+        a = MADV_WILLNEED;
+        break;
+    }
+
+    // Only a hint, so failures are ignored
+    madvise(const_cast<char *>(ptr) + begin, end - begin, a);
+#endif
+}
+
+void MappedFile::close()
+{
+    if (ptr == nullptr) {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(ptr);
+    CloseHandle(mapping);
+    mapping = nullptr;
+#else
+    munmap(const_cast<char *>(ptr), len);
+#endif
+
+    ptr = nullptr;
+    len = 0;
+}
@@ -27,6 +27,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "perfect_platform.h"
 
 #include <cassert>
+#include <cstdint>
 #include <sstream>
 #include <tuple>
 
@@ -305,4 +306,36 @@ int sign(T x)
 
 void failwith(std::string s);
 
+// A read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile() { }
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // Returns false if the file does not exist or cannot be mapped
+    bool open(const std::string &filename);
+    void close();
+
+    enum class Advice { Normal, Random, Sequential, WillNeed };
+
+    // Tells the system how the bytes [offset, offset + n) will be read, so
+    // that it can tune the read-ahead or start reading them in now
+    void advise(Advice advice, size_t offset = 0, size_t n = SIZE_MAX) const;
+
+    bool is_open() const { return ptr != nullptr; }
+    const char *data() const { return ptr; }
+    size_t size() const { return len; }
+
+private:
+    const char *ptr {nullptr};
+    size_t len {0};
+#ifdef _WIN32
+    void *mapping {nullptr};
+#endif
+};
+
 #endif // PERFECT_COMMON_H_INCLUDED
@@ -26,21 +26,6 @@ class Player;
 class GameState;
 class CMove;
 
-GameState::GameState(const GameState &s)
-{
-    T = s.T;
-    phase = s.phase;
-    setStoneCount = s.setStoneCount;
-    stoneCount = s.stoneCount;
-    kle = s.kle;
-    sideToMove = s.sideToMove;
-    moveCount = s.moveCount;
-    over = s.over;
-    winner = s.winner;
-    block = s.block;
-    lastIrrev = s.lastIrrev;
-}
-
 int GameState::futureStoneCount(int p)
 {
     return stoneCount[p] + Rules::maxKSZ - setStoneCount[p];
@@ -64,45 +49,85 @@ void GameState::makeMove(CMove *M)
         throw std::invalid_argument("M is null");
     }
 
-    checkInvariants();
-    checkValidMove(M);
-
-    moveCount++;
-
     SetPiece *sk = dynamic_cast<SetPiece *>(M);
     MovePiece *mk = dynamic_cast<MovePiece *>(M);
     RemovePiece *lk = dynamic_cast<RemovePiece *>(M);
 
     if (sk != nullptr) {
-        T[sk->to] = sideToMove;
-        setStoneCount[sideToMove]++;
-        stoneCount[sideToMove]++;
-        lastIrrev = 0;
+        setPiece(sk->to);
     } else if (mk != nullptr) {
-        T[mk->from] = -1;
-        T[mk->to] = sideToMove;
-        lastIrrev++;
-        if (lastIrrev >= Rules::lastIrrevLimit) {
-            over = true;
-            winner = -1; // draw
-        }
+        movePiece(mk->from, mk->to);
     } else if (lk != nullptr) {
-        T[lk->from] = -1;
-        stoneCount[1 - sideToMove]--;
-        kle = false;
-        if (stoneCount[1 - sideToMove] + Rules::maxKSZ -
-                setStoneCount[1 - sideToMove] <
-            3) {
-            over = true;
-            winner = sideToMove;
-        }
-        lastIrrev = 0;
+        removePiece(lk->from);
+    }
+
+    delete M;
+}
+
+// Hard to ensure that the 'over and winner = -1' case never occurs. For
+// example, the WithTaking case of PerfectPlayer.MakeMoveInState is tricky,
+// because the previous makeMove may have already made it a draw.
+void GameState::setPiece(int to)
+{
+    checkInvariants();
+    assert(!over || winner == -1);
+    assert(phase == 1);
+    assert(T[to] == -1);
+
+    moveCount++;
+    T[to] = sideToMove;
+    setStoneCount[sideToMove]++;
+    stoneCount[sideToMove]++;
+    lastIrrev = 0;
+
+    finishMove(to);
+}
+
+void GameState::movePiece(int from, int to)
+{
+    checkInvariants();
+    assert(!over || winner == -1);
+    assert(T[from] == sideToMove);
+    assert(T[to] == -1);
+
+    moveCount++;
+    T[from] = -1;
+    T[to] = sideToMove;
+    lastIrrev++;
+    if (lastIrrev >= Rules::lastIrrevLimit) {
+        over = true;
+        winner = -1; // draw
+    }
+
+    finishMove(to);
+}
+
+void GameState::removePiece(int from)
+{
+    checkInvariants();
+    assert(!over || winner == -1);
+    assert(kle);
+    assert(T[from] == 1 - sideToMove);
+
+    moveCount++;
+    T[from] = -1;
+    stoneCount[1 - sideToMove]--;
+    kle = false;
+    if (stoneCount[1 - sideToMove] + Rules::maxKSZ -
+            setStoneCount[1 - sideToMove] <
+        3) {
+        over = true;
+        winner = sideToMove;
     }
+    lastIrrev = 0;
+
+    finishMove(-1);
+}
 
-    if ((sk != nullptr && Rules::malome(sk->to, *this) > -1 &&
-         stoneCount[1 - sideToMove] > 0) ||
-        (mk != nullptr && Rules::malome(mk->to, *this) > -1 &&
-         stoneCount[1 - sideToMove] > 0)) {
+void GameState::finishMove(int to)
+{
+    if (to != -1 && Rules::malome(to, *this) > -1 &&
+        stoneCount[1 - sideToMove] > 0) {
         kle = true;
     } else {
         sideToMove = 1 - sideToMove;
@@ -120,36 +145,9 @@ void GameState::makeMove(CMove *M)
         }
     }
 
-    delete M;
-
     checkInvariants();
 }
 
-void GameState::checkValidMove(CMove *M)
-{
-    // Hard to ensure that the 'over and winner = -1' case never occurs. For
-    // example, the WithTaking case of PerfectPlayer.MakeMoveInState is tricky,
-    // because the previous makeMove may have already made it a draw.
-    assert(!over || winner == -1);
-
-    SetPiece *sk = dynamic_cast<SetPiece *>(M);
-    MovePiece *mk = dynamic_cast<MovePiece *>(M);
-    RemovePiece *lk = dynamic_cast<RemovePiece *>(M);
-
-    if (sk != nullptr) {
-        assert(phase == 1);
-        assert(T[sk->to] == -1);
-    }
-    if (mk != nullptr) {
-        assert(T[mk->from] == sideToMove);
-        assert(T[mk->to] == -1);
-    }
-    if (lk != nullptr) {
-        assert(kle);
-        assert(T[lk->from] == 1 - sideToMove);
-    }
-}
-
 void GameState::checkInvariants()
 {
     assert(setStoneCount[0] >= 0);
@@ -272,6 +270,7 @@ std::string GameState::setOverAndCheckValidSetup()
 
 // to paste from clipboard
 GameState::GameState(const std::string &s)
+    : GameState()
 {
     std::vector<std::string> ss;
     std::string temp;
@@ -22,19 +22,23 @@
 #ifndef PERFECT_GAME_STATE_H_INCLUDED
 #define PERFECT_GAME_STATE_H_INCLUDED
 
+#include <array>
 #include <sstream>
+#include <type_traits>
 
 class CMove; // forward declaration, implement this
 
+// The state is trivially copyable, so that the perfect player can copy it for
+// every move it looks at without touching the heap.
 class GameState
 {
 public:
     // The board (-1: empty, 0: white piece, 1: black piece)
-    std::vector<int> T = std::vector<int>(24, -1);
+    std::array<int, 24> T;
     int phase = 1;
     // How many stones the players have set
-    std::vector<int> setStoneCount = std::vector<int>(2, 0);
-    std::vector<int> stoneCount = std::vector<int>(2, 0);
+    std::array<int, 2> setStoneCount {0, 0};
+    std::array<int, 2> stoneCount {0, 0};
     bool kle = false; // Is there a puck removal coming?
     int sideToMove = 0;
     int moveCount = 0;
@@ -43,9 +47,7 @@ public:
     bool block = false;
     int lastIrrev = 0;
 
-    GameState() { } // start of game
-
-    GameState(const GameState &s);
+    GameState() { T.fill(-1); } // start of game
 
     int futureStoneCount(int p);
 
@@ -55,7 +57,10 @@ public:
 
     void makeMove(CMove *M);
 
-    void checkValidMove(CMove *M);
+    // The steps of makeMove(), for the callers which know the kind of the move
+    void setPiece(int to);
+    void movePiece(int from, int to);
+    void removePiece(int from);
 
     void checkInvariants();
 
@@ -69,8 +74,16 @@ public:
 
     // for clipboard
     std::string toString();
+
+private:
+    // Either the mover closed a mill on 'to' and takes a stone next, or the
+    // turn passes to the opponent. 'to' is -1 after a removal.
+    void finishMove(int to);
 };
 
+static_assert(std::is_trivially_copyable<GameState>::value,
+              "GameState is copied for every move of the perfect player");
+
 class InvalidGameStateException : public std::exception
 {
 public:
@@ -27,6 +27,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <cstdint>
 #include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <random>
+#include <string>
 #include <vector>
 
 const int binom[25][25] = {
@@ -97,24 +101,197 @@ int next_choose(int x)
 
 void init_collapse_lookup();
 
-Hash::Hash(int the_w, int the_b, Sector *sec)
+// Rank of x among the bitboards with the same number of stones, in increasing
+// order. This is the order in which next_choose() enumerates them.
+static inline int colex_rank(int x)
+{
+    int r = 0;
+    for (int i = 1; x; i++) {
+        r += binom[CTZ(x)][i];
+        x &= x - 1;
+    }
+    return r;
+}
+
+// Inverse of colex_rank() for bitboards with k stones
+static int colex_unrank(int r, int k)
+{
+    int x = 0;
+    for (int i = k; i > 0; i--) {
+        int c = i - 1;
+        while (binom[c + 1][i] <= r)
+            c++;
+        r -= binom[c][i];
+        x |= 1 << c;
+    }
+    return x;
+}
+
+namespace {
+
+const uint32_t tables_magic = 0x4c424854; // "THBL"
+const int tables_version = 2;
+
+struct TablesHeader
+{
+    uint32_t magic;
+    int32_t version;
+    int32_t W;
+    int32_t n;
+    int32_t f_count;
+    uint32_t checksum; // Of the tables, which follow the header
+};
+
+// The image is the header, f_lookup, f_inv_lookup and f_sym_lookup
+size_t image_size(int n, int f_count)
+{
+    return sizeof(TablesHeader) + sizeof(int) * (n + f_count) + n;
+}
+
+// FNV-1a of the tables of an image of the given size
+uint32_t tables_checksum(const char *image, size_t size)
+{
+    uint32_t h = 2166136261u;
+    const auto *p = reinterpret_cast<const unsigned char *>(image);
+    for (size_t i = sizeof(TablesHeader); i < size; i++)
+        h = (h ^ p[i]) * 16777619u;
+
+    return h;
+}
+
+// A name no other process or thread saving the same tables uses
+std::string temporary_file_name(const std::string &filename)
+{
+    static std::atomic<unsigned> counter {0};
+    std::random_device rd;
+
+    char b[64];
+    SPRINTF(b, sizeof(b), ".%ld.%u.%08x.tmp", static_cast<long>(GETPID()),
+            counter++, static_cast<unsigned>(rd()));
+
+    return filename + b;
+}
+
+std::shared_ptr<const HashTables> cached_tables[25];
+
+std::string tables_file_name(int W)
+{
+    char b[255];
+    SPRINTF(b, sizeof(b), "hash_%d.tbl", W);
+#ifdef _WIN32
+    return sec_val_path + "\\" + b;
+#else
+    return sec_val_path + "/" + b;
+#endif
+}
+
+} // namespace
+
+std::shared_ptr<const HashTables> HashTables::get(int W)
+{
+    if (cached_tables[W] == nullptr) {
+        cached_tables[W] = std::make_shared<const HashTables>(W);
+    }
+
+    return cached_tables[W];
+}
+
+void HashTables::release()
+{
+    for (auto &t : cached_tables) {
+        t.reset();
+    }
+}
+
+void HashTables::release_unused()
+{
+    for (auto &t : cached_tables) {
+        if (t != nullptr && t.use_count() == 1) {
+            t.reset();
+        }
+    }
+}
+
+size_t HashTables::cached_bytes()
+{
+    size_t bytes = 0;
+    for (const auto &t : cached_tables) {
+        if (t != nullptr) {
+            bytes += t->memory_usage();
+        }
+    }
+    return bytes;
+}
+
+size_t HashTables::memory_usage() const
+{
+    return file.is_open() ? file.size() : buf.size();
+}
+
+HashTables::HashTables(int the_w)
     : W(the_w)
-    , B(the_b)
-    , s(sec)
+    , n(binom[24][the_w])
 {
-    g_lookup = new int[1LL << (24 - W)];
+    const std::string filename = tables_file_name(W);
+
+    if (load(filename)) {
+        return;
+    }
+
+    LOG("Building hash tables for W = %d\n", W);
+    build();
+    save(filename);
+
+    // Map the saved file, so that the pages are shared with other processes
+    if (load(filename)) {
+        std::vector<char>().swap(buf);
+    }
+
+#ifdef _DEBUG
+    check_hash_init_consistency();
+#endif
+}
+
+bool HashTables::load(const std::string &filename)
+{
+    if (!file.open(filename)) {
+        return false;
+    }
+
+    TablesHeader h;
+    if (file.size() < sizeof(h)) {
+        file.close();
+        return false;
+    }
+    memcpy(&h, file.data(), sizeof(h));
+
+    if (h.magic != tables_magic || h.version != tables_version || h.W != W ||
+        h.n != n || file.size() != image_size(n, h.f_count) ||
+        h.checksum != tables_checksum(file.data(), file.size())) {
+        // Stale, truncated or corrupted, it will be rebuilt
+        file.close();
+        return false;
+    }
+
+    set_pointers(file.data());
+
+    return true;
+}
+
+void HashTables::build()
+{
+    std::vector<int> f(n, -1);
+    std::vector<int> f_inv;
+    std::vector<int8_t> f_sym(n, 0);
 
-    memset(f_lookup, -1, sizeof(f_lookup));
-    memset(f_sym_lookup2, 0, sizeof(f_sym_lookup2));
     int c = 0;
     for (int w = (1 << W) - 1; w < 1 << 24; w = next_choose(w))
-        if (f_lookup[w] == -1) {
+        if (f[colex_rank(w)] == -1) {
             for (int i = 0; i < 16; i++) {
                 // for(int i=15; i>=0; i--){
-                auto sw = sym24(i, w);
-                f_lookup[sw] = c;
-                f_sym_lookup[sw] = inv[i];
-                f_sym_lookup2[sw] |= 1 << inv[i];
+                auto sw = colex_rank(static_cast<int>(sym24(i, w)));
+                f[sw] = c;
+                f_sym[sw] = inv[i];
             }
             /*
             We call a state canonical that can be hashed (i.e., the inv_hash may
@@ -158,80 +335,121 @@ Hash::Hash(int the_w, int the_b, Sector *sec)
             in.
             */
             // f_sym_lookup[w]=0;
+
+            // The bitboards are enumerated in increasing order, so w is the
+            // smallest member of its orbit.
+            f_inv.push_back(w);
             c++;
         }
 
     f_count = c;
-    f_inv_lookup = new int[f_count];
 
-    std::vector<int> ws;
-    for (int w = (1 << W) - 1; w < 1 << 24; w = next_choose(w))
-        ws.push_back(w);
-    reverse(ws.begin(), ws.end());
-    for (auto it = ws.begin(); it != ws.end(); ++it) {
-        auto w = *it;
-        f_inv_lookup[f_lookup[w]] = w;
+    buf.resize(image_size(n, f_count));
+    char *p = buf.data() + sizeof(TablesHeader);
+    memcpy(p, f.data(), sizeof(int) * n);
+    p += sizeof(int) * n;
+    memcpy(p, f_inv.data(), sizeof(int) * f_count);
+    p += sizeof(int) * f_count;
+    memcpy(p, f_sym.data(), n);
+
+    const TablesHeader h {tables_magic, tables_version, W, n, f_count,
+                          tables_checksum(buf.data(), buf.size())};
+    memcpy(buf.data(), &h, sizeof(h));
+
+    set_pointers(buf.data());
+}
+
+void HashTables::save(const std::string &filename) const
+{
+    // Write to a temporary file of our own first, so that other processes
+    // never map a partially written one nor write into ours. Failing to save
+    // is not an error: the database directory may be read-only, and the
+    // tables are built again next time.
+    const std::string tmp = temporary_file_name(filename);
+
+    FILE *out = nullptr;
+    if (FOPEN(&out, tmp.c_str(), "wb") != 0) {
+        return;
     }
 
-    g_inv_lookup = new int[binom[24 - W][B]];
-    c = 0;
-    for (int b = (1 << B) - 1; b < 1 << (24 - W); b = next_choose(b)) {
-        if (c >= binom[24 - W][B]) {
-            assert(false);
-            break;
-        }
-        g_lookup[b] = c;
-        g_inv_lookup[c] = b;
-        c++;
+    bool ok = fwrite(buf.data(), 1, buf.size(), out) == buf.size();
+    ok = fclose(out) == 0 && ok;
+
+    std::remove(filename.c_str());
+    if (!ok || std::rename(tmp.c_str(), filename.c_str()) != 0) {
+        std::remove(tmp.c_str());
     }
+}
 
-    hash_count = f_count * binom[24 - W][B];
+void HashTables::set_pointers(const char *image)
+{
+    TablesHeader h;
+    memcpy(&h, image, sizeof(h));
+    f_count = h.f_count;
 
-    init_collapse_lookup();
+    image += sizeof(h);
+    f_lookup = reinterpret_cast<const int *>(image);
+    f_inv_lookup = f_lookup + n;
+    f_sym_lookup = reinterpret_cast<const int8_t *>(f_inv_lookup + f_count);
+}
 
-#ifdef _DEBUG
-#ifndef WRAPPER // The Wrapper uses the manual popcnt, which makes this
-                // noticeably slow when playing
-    check_hash_init_consistency();
-#endif
-#endif
+void HashTables::check_hash_init_consistency() const
+{
+    for (int i = 0; i < n; i++) {
+        assert(f_lookup[i] >= 0 && f_lookup[i] < f_count);
+        assert(f_sym_lookup[i] >= 0 && f_sym_lookup[i] < 16);
+    }
 }
 
-void Hash::check_hash_init_consistency()
+Hash::Hash(int the_w, int the_b, Sector *sec)
+    : W(the_w)
+    , B(the_b)
+    , tables(HashTables::get(the_w))
+    , g_count(binom[24 - the_w][the_b])
+    , s(sec)
 {
-    for (int i = 0; i < 1 << 24; i++)
-        if (static_cast<int>(POPCNT(i)) == W)
-            assert(f_sym_lookup[i] >= 0 && f_sym_lookup[i] < 16);
+    hash_count = tables->f_count * g_count;
+
+    init_collapse_lookup();
 }
 
-Hash::~Hash()
+size_t Hash::memory_usage() const
 {
-    delete[] f_inv_lookup;
-    delete[] g_lookup;
-    delete[] g_inv_lookup;
+    return sizeof(Hash);
 }
 
+// The symmetry operations keep the white part in its orbit, so the f part of
+// the hash is the same before and after them.
 std::pair<int, eval_elem2> Hash::hash(board a)
 {
-    a = sym48(f_sym_lookup[a & mask24], a);
-    int h1 = f_lookup[a & mask24] * binom[24 - W][B] + g_lookup[collapse(a)];
+    const int r = colex_rank(static_cast<int>(a & mask24));
+    const int f = tables->f_lookup[r] * g_count;
+
+    a = sym48(tables->f_sym_lookup[r], a);
+    int h1 = f + colex_rank(collapse(a));
     eval_elem_sym2 e = s->get_eval_inner(h1);
     if (e.cas() != eval_elem_sym2::Sym)
         return std::make_pair(h1, e);
     else {
         a = sym48(e.sym(), a);
-        int h2 = f_lookup[a & mask24] * binom[24 - W][B] +
-                 g_lookup[collapse(a)];
+        int h2 = f + colex_rank(collapse(a));
         assert(s->get_eval_inner(h2).cas() != eval_elem_sym2::Sym);
         return std::make_pair(h2, s->get_eval(h2));
     }
 }
 
+int Hash::index(board a) const
+{
+    const int r = colex_rank(static_cast<int>(a & mask24));
+    a = sym48(tables->f_sym_lookup[r], a);
+    return tables->f_lookup[r] * g_count + colex_rank(collapse(a));
+}
+
 board Hash::inv_hash(int h)
 {
-    int m = binom[24 - W][B];
-    int f = h / m, g = h % m;
-    return uncollapse(f_inv_lookup[f] | ((board)g_inv_lookup[g] << 24));
+    int f = h / g_count, g = h % g_count;
+    return uncollapse(tables->f_inv_lookup[f] |
+                      ((board)colex_unrank(g, B) << 24));
 }
 
 board uncollapse(board a)
@@ -27,21 +27,67 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "perfect_sector.h"
 
 #include <cstring>
+#include <memory>
+#include <vector>
 
 // void init_hash_lookuptables();
 
+// The lookup tables of the white part of the hash function. They depend only
+// on the number of white stones, so all the sectors with the same W share one
+// instance. They are indexed by the colex rank of the white bitboard among the
+// bitboards with W stones, which keeps them small.
+//
+// The tables are saved next to the database the first time they are built.
+// Later sessions, and other processes, map that file instead of rebuilding
+// them.
+class HashTables
+{
+public:
+    // Returns the tables of W, loading or building them if needed
+    static std::shared_ptr<const HashTables> get(int W);
+
+    // Drops the cached tables. Hash objects still holding them keep them alive.
+    static void release();
+
+    // Drops the cached tables which no hash object holds
+    static void release_unused();
+
+    // Bytes of the cached tables, mapped or in memory
+    static size_t cached_bytes();
+
+    explicit HashTables(int the_w);
+
+    int W;
+    int n;           // Number of white bitboards with W stones
+    int f_count {0}; // Number of orbits of those under the symmetries
+
+    const int *f_lookup {nullptr};       // rank -> orbit
+    const int *f_inv_lookup {nullptr};   // orbit -> canonical bitboard
+    const int8_t *f_sym_lookup {nullptr}; // rank -> symmetry op to canonical
+
+    void check_hash_init_consistency() const;
+
+    // Bytes of the tables, mapped or in memory
+    size_t memory_usage() const;
+
+private:
+    bool load(const std::string &filename);
+    void build();
+    void save(const std::string &filename) const;
+    void set_pointers(const char *image);
+
+    // The tables are either mapped from the file or held in the buffer
+    MappedFile file;
+    std::vector<char> buf;
+};
+
 class Hash
 {
-    int W, B; // It might be worth to put these after the large arrays for cache
-              // locality reasons
+    int W, B;
 
-    int f_lookup[1 << 24] {0};
-    char f_sym_lookup[1 << 24] {0}; // Converted from int to char
-    int *f_inv_lookup {nullptr};
-    int *g_lookup {nullptr};
-    int *g_inv_lookup {nullptr};
+    std::shared_ptr<const HashTables> tables;
 
-    int f_count {0};
+    int g_count {0}; // Number of black bitboards for one white bitboard
 
     Sector *s {nullptr};
 
@@ -51,13 +97,14 @@ public:
     std::pair<int, eval_elem2> hash(board a);
     board inv_hash(int h);
 
-    int hash_count {0};
-
-    unsigned short f_sym_lookup2[1 << 24];
+    // The index of a in the sector, without reading its value. Positions
+    // which are symmetric to each other may have different indices.
+    int index(board a) const;
 
-    void check_hash_init_consistency();
+    int hash_count {0};
 
-    ~Hash();
+    // Bytes held by this object, not counting the shared tables
+    size_t memory_usage() const;
 };
 
 int collapse(board a);
@@ -34,13 +34,29 @@
 
 #define FOPEN(file, filename, mode) fopen_s(file, filename, mode)
 
+#define GETPID() _getpid()
+
 #define STRCPY(destination, destination_size, source) \
     strcpy_s(destination, destination_size, source)
 
 #define POPCNT(x) __popcnt(x)
 
+#include <intrin.h>
+#include <process.h>
+
+inline unsigned int ctz32(unsigned int x)
+{
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return index;
+}
+
+#define CTZ(x) ctz32(x)
+
 #else // _WIN32
 
+#include <unistd.h>
+
 #if defined(__APPLE__) && defined(__MACH__)
 #define SPRINTF(buffer, buffer_size, format, ...) \
     snprintf(buffer, buffer_size, format __VA_OPT__(, ) __VA_ARGS__)
@@ -68,12 +84,16 @@
 #define FOPEN(file, filename, mode) \
     ((*file = fopen(filename, mode)) != NULL ? 0 : -1)
 
+#define GETPID() getpid()
+
 #define STRCPY(destination, destination_size, source) \
     strncpy(destination, source, destination_size - 1); \
     destination[destination_size - 1] = '\0'
 
 #define POPCNT(x) __builtin_popcount(x)
 
+#define CTZ(x) __builtin_ctz(x)
+
 #endif // _WIN32
 
 #endif // PERFECT_PLATFORM_H_INCLUDED
@@ -28,8 +28,10 @@
 
 #include "perfect_wrappers.h"
 
+#include <algorithm>
 #include <bitset>
 #include <cassert>   // for assert
+#include <cctype>
 #include <cstdint>   // for int64_t
 #include <cstdlib>   // for std::exit
 #include <exception> // for std::exception
@@ -42,8 +44,15 @@
 #include <stdexcept>
 #include <stdexcept> // for std::out_of_range
 #include <string>
+#include <unordered_set>
 #include <vector>
 
+#if defined(__APPLE__)
+#include <dirent.h>
+#else
+#include <filesystem>
+#endif
+
 #include "option.h"
 
 class GameState;
@@ -51,7 +60,49 @@ class GameState;
 std::map<Wrappers::WID, Wrappers::WSector> Sectors::sectors;
 bool Sectors::created = false;
 
-std::map<Wrappers::WID, Wrappers::WSector> Sectors::getSectors()
+namespace {
+
+// The name of a directory entry as it is looked up. The file systems of
+// Windows, and of macOS by default, do not tell names apart by case, so a
+// file is found there whatever the case of its name.
+std::string entryKey(std::string name)
+{
+#if defined(_WIN32) || defined(__APPLE__)
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+#endif
+    return name;
+}
+
+// Collects the names of the entries of the directory at path, see entryKey().
+// Returns false if the directory cannot be listed.
+bool listDirectory(const std::string &path,
+                   std::unordered_set<std::string> &names)
+{
+#if defined(__APPLE__)
+    DIR *dir = opendir(path.c_str());
+    if (dir == nullptr) {
+        return false;
+    }
+    while (const dirent *entry = readdir(dir)) {
+        names.emplace(entryKey(entry->d_name));
+    }
+    closedir(dir);
+    return true;
+#else
+    std::error_code ec;
+    std::filesystem::directory_iterator it(path, ec), end;
+    for (; !ec && it != end; it.increment(ec)) {
+        names.emplace(entryKey(it->path().filename().string()));
+    }
+    return !ec;
+#endif
+}
+
+} // namespace
+
+std::map<Wrappers::WID, Wrappers::WSector> &Sectors::getSectors()
 {
     try {
         if (!created) {
@@ -59,24 +110,35 @@ std::map<Wrappers::WID, Wrappers::WSector> Sectors::getSectors()
             Wrappers::Init::init_sec_vals();
             // sectors.clear();
 
+            // Opening every possible sector file to see whether it exists
+            // takes thousands of round trips on network and Android storage,
+            // so list the directory once instead. Only if that fails are the
+            // files opened one by one.
+            std::unordered_set<std::string> present;
+            const bool listed = listDirectory(sec_val_path, present);
+
             for (int w = 0; w <= Rules::maxKSZ; ++w) {
                 for (int b = 0; b <= Rules::maxKSZ; ++b) {
                     for (int wf = 0; wf <= Rules::maxKSZ; ++wf) {
                         for (int bf = 0; bf <= Rules::maxKSZ; ++bf) {
-                            std::string fname =
-                                Rules::variantName + "_" + std::to_string(w) +
-                                "_" + std::to_string(b) + "_" +
-                                std::to_string(wf) + "_" + std::to_string(bf) +
-                                ".sec" + Wrappers::Constants::fname_suffix;
+                            // The name Sector::allocate_hash() opens
+                            std::string fname = ::Id(w, b, wf, bf).file_name();
                             // std::cout << "Looking for database file " <<
                             // fname << std::endl;
                             Wrappers::WID _id(w, b, wf, bf);
+                            bool found;
+                            if (listed) {
+                                found = present.count(entryKey(fname)) > 0;
+                            } else {
 #ifdef _WIN32
-                            std::ifstream file(sec_val_path + "\\" + fname);
+                                std::ifstream file(sec_val_path + "\\" +
+                                                   fname);
 #else
-                            std::ifstream file(sec_val_path + "/" + fname);
+                                std::ifstream file(sec_val_path + "/" + fname);
 #endif
-                            if (file.good()) {
+                                found = file.good();
+                            }
+                            if (found) {
                                 sectors.emplace(_id, Wrappers::WSector(_id));
                             }
                         }
@@ -102,6 +164,22 @@ bool Sectors::hasDatabase()
     return getSectors().size() > 0;
 }
 
+void Sectors::release()
+{
+    // The hash objects refer to the sectors, so release them first
+    Wrappers::WSector::releaseHashes();
+    HashTables::release();
+
+    for (auto &sector : sectors) {
+        delete sector.second.s;
+    }
+
+    sectors.clear();
+    sec_vals.clear();
+    inv_sec_vals.clear();
+    created = false;
+}
+
 // The object is informed to enter the specified game
 void Player::enter(Game *_g)
 {
@@ -117,9 +195,9 @@ void Player::quit()
 }
 
 PerfectPlayer::PerfectPlayer()
+    : secs(Sectors::getSectors())
 {
-    assert(Sectors::hasDatabase());
-    secs = Sectors::getSectors();
+    assert(!secs.empty());
 }
 
 void PerfectPlayer::enter(Game *_g)
@@ -127,7 +205,7 @@ void PerfectPlayer::enter(Game *_g)
     Player::enter(_g);
 }
 
-Wrappers::WSector *PerfectPlayer::getSec(GameState s)
+Wrappers::WSector *PerfectPlayer::getSec(const GameState &s)
 {
     try {
         if (s.kle)
@@ -191,21 +269,18 @@ bool PerfectPlayer::isMill(const GameState &s, int m)
     return -1 != Rules::malome(m, s);
 }
 
-std::vector<AdvancedMove> PerfectPlayer::setMoves(const GameState &s)
+void PerfectPlayer::setMoves(const GameState &s, AdvancedMoveList &r)
 {
-    std::vector<AdvancedMove> r;
     for (int i = 0; i < 24; ++i) {
         if (s.T[i] == -1) {
             r.push_back(AdvancedMove {i, i, CMoveType::SetMove,
                                       makesMill(s, -1, i), false, 0});
         }
     }
-    return r;
 }
 
-std::vector<AdvancedMove> PerfectPlayer::slideMoves(const GameState &s)
+void PerfectPlayer::slideMoves(const GameState &s, AdvancedMoveList &r)
 {
-    std::vector<AdvancedMove> r;
     for (int i = 0; i < 24; ++i) {
         for (int j = 0; j < 24; ++j) {
             if (s.T[i] == s.sideToMove && s.T[j] == -1 &&
@@ -215,16 +290,13 @@ std::vector<AdvancedMove> PerfectPlayer::slideMoves(const GameState &s)
             }
         }
     }
-    return r;
 }
 
 // m has a withTaking step, where takeHon is not filled out. This function
-// creates a list, the elements of which are copies of m supplemented with one
-// possible removal each.
-std::vector<AdvancedMove> PerfectPlayer::withTakingMoves(const GameState &s,
-                                                         AdvancedMove &m)
+// appends copies of m supplemented with one possible removal each.
+void PerfectPlayer::withTakingMoves(const GameState &s, const AdvancedMove &m,
+                                    AdvancedMoveList &r)
 {
-    std::vector<AdvancedMove> r;
     bool everythingInMill = true;
     for (int i = 0; i < 24; ++i) {
         if (s.T[i] == 1 - s.sideToMove && !isMill(s, i)) {
@@ -239,13 +311,11 @@ std::vector<AdvancedMove> PerfectPlayer::withTakingMoves(const GameState &s,
             r.push_back(m2);
         }
     }
-    return r;
 }
 
-std::vector<AdvancedMove> PerfectPlayer::onlyTakingMoves(const GameState &s)
+void PerfectPlayer::onlyTakingMoves(const GameState &s, AdvancedMoveList &r)
 {
     // there's some copy-paste code here
-    std::vector<AdvancedMove> r;
     bool everythingInMill = true;
     for (int i = 0; i < 24; ++i) {
         if (s.T[i] == 1 - s.sideToMove && !isMill(s, i)) {
@@ -260,7 +330,6 @@ std::vector<AdvancedMove> PerfectPlayer::onlyTakingMoves(const GameState &s)
                                            // and to
         }
     }
-    return r;
 }
 
 #ifdef _MSC_VER
@@ -270,40 +339,37 @@ std::vector<AdvancedMove> PerfectPlayer::onlyTakingMoves(const GameState &s)
 #pragma warning(disable : 6285)
 #endif
 
-std::vector<AdvancedMove> PerfectPlayer::getMoveList(const GameState &s)
+void PerfectPlayer::getMoveList(const GameState &s, AdvancedMoveList &r)
 {
-    std::vector<AdvancedMove> ms0, ms;
-    if (!s.kle) {
-        if (ruleVariant == (int)Wrappers::Constants::Variants::std ||
-            ruleVariant == (int)Wrappers::Constants::Variants::mora) {
-            if (s.setStoneCount[s.sideToMove] < Rules::maxKSZ) {
-                ms0 = setMoves(s);
-            } else {
-                ms0 = slideMoves(s);
-            }
-        } else { // Lasker
-            ms0 = slideMoves(s);
-            if (s.setStoneCount[s.sideToMove] < Rules::maxKSZ) {
-                std::vector<AdvancedMove> setMovesResult = setMoves(s);
-                ms0.insert(ms0.end(), setMovesResult.begin(),
-                           setMovesResult.end());
-            }
+    r.clear();
+
+    if (s.kle) {
+        onlyTakingMoves(s, r);
+        return;
+    }
+
+    AdvancedMoveList ms0;
+    if (ruleVariant == (int)Wrappers::Constants::Variants::std ||
+        ruleVariant == (int)Wrappers::Constants::Variants::mora) {
+        if (s.setStoneCount[s.sideToMove] < Rules::maxKSZ) {
+            setMoves(s, ms0);
+        } else {
+            slideMoves(s, ms0);
         }
+    } else { // Lasker
+        slideMoves(s, ms0);
+        if (s.setStoneCount[s.sideToMove] < Rules::maxKSZ) {
+            setMoves(s, ms0);
+        }
+    }
 
-        for (size_t i = 0; i < ms0.size(); ++i) {
-            if (!ms0[i].withTaking) {
-                ms.push_back(ms0[i]);
-            } else {
-                std::vector<AdvancedMove> withTakingMovesResult =
-                    withTakingMoves(s, ms0[i]);
-                ms.insert(ms.end(), withTakingMovesResult.begin(),
-                          withTakingMovesResult.end());
-            }
+    for (const AdvancedMove &m : ms0) {
+        if (!m.withTaking) {
+            r.push_back(m);
+        } else {
+            withTakingMoves(s, m, r);
         }
-    } else { // kle
-        ms = onlyTakingMoves(s);
     }
-    return ms;
 }
 
 #ifdef _MSC_VER
@@ -311,26 +377,27 @@ std::vector<AdvancedMove> PerfectPlayer::getMoveList(const GameState &s)
 #pragma warning(pop)
 #endif
 
-GameState PerfectPlayer::makeMoveInState(const GameState &s, AdvancedMove &m)
+GameState PerfectPlayer::makeMoveInState(const GameState &s,
+                                         const AdvancedMove &m)
 {
     GameState s2(s);
     if (!m.onlyTaking) {
         if (m.moveType == CMoveType::SetMove) {
-            s2.makeMove(new SetPiece(m.to));
+            s2.setPiece(m.to);
         } else {
-            s2.makeMove(new MovePiece(m.from, m.to));
+            s2.movePiece(m.from, m.to);
         }
         if (m.withTaking)
-            s2.makeMove(new RemovePiece(m.takeHon));
+            s2.removePiece(m.takeHon);
     } else {
-        s2.makeMove(new RemovePiece(m.takeHon));
+        s2.removePiece(m.takeHon);
     }
     return s2;
 }
 
 // Assuming gui_eval_elem2 and getSec functions are defined somewhere
 Wrappers::gui_eval_elem2 PerfectPlayer::moveValue(const GameState &s,
-                                                  AdvancedMove &m)
+                                                  const AdvancedMove &m)
 {
     try {
         return eval(makeMoveInState(s, m)).undo_negate(getSec(s));
@@ -342,119 +409,136 @@ Wrappers::gui_eval_elem2 PerfectPlayer::moveValue(const GameState &s,
     }
 }
 
-template <typename T, typename K>
-std::vector<T> PerfectPlayer::allMaxBy(std::function<K(T)> f,
-                                       const std::vector<T> &l, K minValue,
-                                       Value &value)
+void PerfectPlayer::moveValues(const GameState &s, const AdvancedMoveList &ms,
+                               Wrappers::gui_eval_elem2 *values)
 {
-    std::vector<T> r;
+    try {
+        Wrappers::WSector *sec = getSec(s);
 
-    // TODO: Right? Ref: https://github.com/ggevay/malom/pull/3
-    if (gameOptions.getAlgorithm() != 4 ||
-        (gameOptions.getAlgorithm() == 4 &&
-         gameOptions.getAiIsLazy() == true)) {
-        bool foundW = false;
-        bool foundD = false;
+        struct Child
+        {
+            Wrappers::WID id;
+            board a;
+            size_t i;
+        };
 
-        for (auto &m : l) {
-            K e = f(m);
-            std::string eStr = e.toString();
+        Child children[MAX_PERFECT_MOVES];
+        size_t n = 0;
 
-            if (eStr[0] == 'W') {
-                if (!foundW) {
-                    r.clear();
-                    foundW = true;
-                }
-                r.push_back(m);
-            } else if (!foundW && eStr[0] != 'L') {
-                if (!foundD) {
-                    r.clear();
-                    foundD = true;
-                }
-                r.push_back(m);
-            } else if (!foundW && !foundD && eStr[0] == 'L') {
-                r.push_back(m);
+        for (size_t i = 0; i < ms.size(); ++i) {
+            GameState s2 = makeMoveInState(s, ms[i]);
+            assert(!s2.kle);
+
+            if (futurePieceCount(s2) < 3) {
+                values[i] = Wrappers::gui_eval_elem2::virt_loss_val()
+                                .undo_negate(sec);
+                continue;
             }
+
+            Child &c = children[n++];
+            c.id = evalKey(s2, c.a);
+            c.i = i;
         }
-    } else {
-        K ma = minValue;
-        for (auto &m : l) {
-            K e = f(m);
-            if (e > ma) {
-                ma = e;
-                r.clear();
-                r.push_back(m);
-            } else if (e == ma) {
-                r.push_back(m);
+
+        std::sort(children, children + n, [](const Child &x, const Child &y) {
+            return x.id < y.id;
+        });
+
+        board boards[MAX_PERFECT_MOVES];
+        Wrappers::gui_eval_elem2 probed[MAX_PERFECT_MOVES];
+
+        for (size_t begin = 0, end; begin < n; begin = end) {
+            end = begin + 1;
+            while (end < n && children[end].id == children[begin].id) {
+                ++end;
+            }
+
+            auto it = secs.find(children[begin].id);
+            if (it == secs.end()) {
+                throw std::out_of_range("Database file for the key not found");
+            }
+
+            for (size_t j = begin; j < end; ++j) {
+                boards[j - begin] = children[j].a;
             }
+
+            it->second.hash(boards, end - begin, probed);
+
+            for (size_t j = begin; j < end; ++j) {
+                values[children[j].i] = probed[j - begin].undo_negate(sec);
+            }
+        }
+    } catch (const std::exception &ex) {
+        std::cerr << "An error happened in " << __func__ << "\n"
+                  << ex.what() << std::endl;
+        throw std::runtime_error(std::string("An error happened in ") +
+                                 __func__ + ": " + ex.what());
+    }
+}
+
+template <typename K, typename Better>
+void PerfectPlayer::allMaxBy(const AdvancedMoveList &l, const K *values,
+                             Better better, AdvancedMoveList &r, Value &value)
+{
+    r.clear();
+    size_t first = 0; // Index of r[0] in l
+
+    for (size_t i = 0; i < l.size(); ++i) {
+        if (r.empty() || better(values[i], values[first])) {
+            r.clear();
+            first = i;
+        } else if (better(values[first], values[i])) {
+            continue;
         }
+        r.push_back(l[i]);
+    }
+
+    if (r.empty()) {
+        throw std::out_of_range("No moves to choose from");
     }
 
-    char e = f(r.at(0)).toString().at(0);
+    const int e = values[first].outcome();
 
-    if (e == 'L') {
+    if (e < 0) {
         value = -VALUE_MATE;
-    } else if (e == 'W') {
+    } else if (e > 0) {
         value = VALUE_MATE;
     } else {
         value = VALUE_DRAW;
     }
-
-    return r;
 }
 
-#if 1
-// Assuming the definition of gui_eval_elem2::min_value function
-std::vector<AdvancedMove> PerfectPlayer::goodMoves(const GameState &s,
-                                                   Value &value)
+void PerfectPlayer::goodMoves(const GameState &s, Value &value,
+                              AdvancedMoveList &r)
 {
-    return allMaxBy(std::function<Wrappers::gui_eval_elem2(AdvancedMove)>(
-                        [this, &s](AdvancedMove m) { return moveValue(s, m); }),
-                    getMoveList(s),
-                    Wrappers::gui_eval_elem2::min_value(getSec(s)), value);
-}
-#else
-std::vector<AdvancedMove> PerfectPlayer::goodMoves(const GameState &s,
-                                                   Value &value)
-{
-    auto moveList = getMoveList(s);
-    std::cout << "Move list size: " << moveList.size() << std::endl;
-
-    std::function<Wrappers::gui_eval_elem2(AdvancedMove)> evalFunction =
-        [this, &s](AdvancedMove m) {
-            auto value = moveValue(s, m);
-            std::cout << "Evaluating move from " << m.from << " to " << m.to
-                      << " with score: " << value.toString() << std::endl;
-            return value;
-        };
+    AdvancedMoveList moveList;
+    Wrappers::gui_eval_elem2 values[MAX_PERFECT_MOVES];
 
-    auto bestMoves = allMaxBy(evalFunction, moveList,
-                              Wrappers::gui_eval_elem2::min_value(getSec(s)),
-                              value);
-
-    std::cout << "Number of best moves: " << bestMoves.size() << std::endl;
-
-#if 0
-    // Filter bestMoves based on Mill condition
-    std::vector<AdvancedMove> filteredMoves;
-    for (const auto &move : bestMoves) {
-        if (!isMill(s, move.to)) {
-            filteredMoves.push_back(move);
-        }
-    }
+    getMoveList(s, moveList);
+    moveValues(s, moveList, values);
 
-    if (filteredMoves.size() > 0) {
-        bestMoves = filteredMoves;
-        std::cout << "Number of best moves after filtering: "
-                  << bestMoves.size() << std::endl;
+    // TODO: Right? Ref: https://github.com/ggevay/malom/pull/3
+    if (gameOptions.getAlgorithm() != 4 ||
+        (gameOptions.getAlgorithm() == 4 &&
+         gameOptions.getAiIsLazy() == true)) {
+        // Only win, draw or loss matters, not how fast
+        allMaxBy(
+            moveList, values,
+            [](const Wrappers::gui_eval_elem2 &x,
+               const Wrappers::gui_eval_elem2 &y) {
+                return x.outcome() > y.outcome();
+            },
+            r, value);
+    } else {
+        allMaxBy(
+            moveList, values,
+            [](const Wrappers::gui_eval_elem2 &x,
+               const Wrappers::gui_eval_elem2 &y) { return x > y; },
+            r, value);
     }
-#endif
-
-    return bestMoves;
 }
-#endif
 
-int PerfectPlayer::NGMAfterMove(const GameState &s, AdvancedMove &m)
+int PerfectPlayer::NGMAfterMove(const GameState &s, const AdvancedMove &m)
 {
     return numGoodMoves(makeMoveInState(s, m));
 }
@@ -479,15 +563,18 @@ int PerfectPlayer::numGoodMoves(const GameState &s)
     auto ma = Wrappers::gui_eval_elem2::min_value(getSec(s)); // Assuming getSec
                                                               // function is
                                                               // defined
-    AdvancedMove mh;
+    AdvancedMoveList moveList;
+    Wrappers::gui_eval_elem2 values[MAX_PERFECT_MOVES];
+
+    getMoveList(s, moveList);
+    moveValues(s, moveList, values);
+
     int c = 0;
-    for (auto &m : getMoveList(s)) {
-        auto e = moveValue(s, m);
-        if (e > ma) {
-            ma = e;
-            mh = m;
+    for (size_t i = 0; i < moveList.size(); ++i) {
+        if (values[i] > ma) {
+            ma = values[i];
             c = 1;
-        } else if (e == ma) {
+        } else if (values[i] == ma) {
             c++;
         }
     }
@@ -502,34 +589,18 @@ struct MoveValuePair
     double val;
 };
 
-std::mutex evalLock;
-
-Wrappers::gui_eval_elem2 PerfectPlayer::eval(GameState s)
+// Thread-safe: secs is not modified after construction, and WSector::hash()
+// handles concurrent probes.
+Wrappers::gui_eval_elem2 PerfectPlayer::eval(const GameState &s)
 {
     try {
-        std::lock_guard<std::mutex> lock(evalLock);
         assert(!s.kle); // Assuming s has a boolean member kle
 
-        Wrappers::WID Id(s.stoneCount[0], s.stoneCount[1],
-                         Rules::maxKSZ - s.setStoneCount[0],
-                         Rules::maxKSZ - s.setStoneCount[1]);
-
         if (futurePieceCount(s) < 3)
             return Wrappers::gui_eval_elem2::virt_loss_val();
 
-        int64_t a = 0;
-        for (int i = 0; i < 24; ++i) {
-            if (s.T[i] == 0) {
-                a |= (1ll << i);
-            } else if (s.T[i] == 1) {
-                a |= (1ll << (i + 24));
-            }
-        }
-
-        if (s.sideToMove == 1) {
-            a = boardNegate(a);
-            Id.negate();
-        }
+        board a;
+        Wrappers::WID Id = evalKey(s, a);
 
         auto it = secs.find(Id);
         if (it == secs.end()) {
@@ -549,6 +620,71 @@ Wrappers::gui_eval_elem2 PerfectPlayer::eval(GameState s)
     }
 }
 
+bool PerfectPlayer::probe(const GameState &s, Wrappers::gui_eval_elem2 &e)
+{
+    if (!s.kle) {
+        return probeNoTaking(s, e);
+    }
+
+    // The best of the removals, in the viewpoint of getSec(s) (none) as
+    // moveValues() computes them
+    AdvancedMoveList moveList;
+    onlyTakingMoves(s, moveList);
+
+    for (size_t i = 0; i < moveList.size(); ++i) {
+        Wrappers::gui_eval_elem2 v;
+        if (!probeNoTaking(makeMoveInState(s, moveList[i]), v)) {
+            return false;
+        }
+
+        v = v.undo_negate(nullptr);
+        if (i == 0 || v > e) {
+            e = v;
+        }
+    }
+
+    return !moveList.empty();
+}
+
+bool PerfectPlayer::probeNoTaking(const GameState &s,
+                                  Wrappers::gui_eval_elem2 &e)
+{
+    assert(!s.kle);
+
+    if (futurePieceCount(s) < 3) {
+        e = Wrappers::gui_eval_elem2::virt_loss_val();
+        return true;
+    }
+
+    board a;
+    auto it = secs.find(evalKey(s, a));
+
+    return it != secs.end() && it->second.hashIfResident(a, e);
+}
+
+Wrappers::WID PerfectPlayer::evalKey(const GameState &s, board &a)
+{
+    Wrappers::WID Id(s.stoneCount[0], s.stoneCount[1],
+                     Rules::maxKSZ - s.setStoneCount[0],
+                     Rules::maxKSZ - s.setStoneCount[1]);
+
+    a = 0;
+    for (int i = 0; i < 24; ++i) {
+        if (s.T[i] == 0) {
+            a |= (1ll << i);
+        } else if (s.T[i] == 1) {
+            a |= (1ll << (i + 24));
+        }
+    }
+
+    if (s.sideToMove == 1) {
+        a = boardNegate(a);
+        Id.negate();
+    }
+
+    return Id;
+}
+
 int64_t PerfectPlayer::boardNegate(int64_t a)
 {
     return ((a & mask24) << 24) | ((a & (mask24 << 24)) >> 24);
@@ -81,15 +81,53 @@ struct AdvancedMove
     }
 };
 
+// A move closing a mill is a choice of a stone to move or to place (from the
+// hand, in Lasker), an empty square and an opponent stone to take. With a
+// stones of the mover, e empty squares and b opponent stones, we have
+// (a + 1) + e + b <= 25, so a position has at most 9 * 8 * 8 moves.
+constexpr size_t MAX_PERFECT_MOVES = 576;
+
+// The moves of a position, without touching the heap
+struct AdvancedMoveList
+{
+    const AdvancedMove *begin() const { return moveList; }
+
+    const AdvancedMove *end() const { return moveList + n; }
+
+    size_t size() const { return n; }
+
+    bool empty() const { return n == 0; }
+
+    void clear() { n = 0; }
+
+    void push_back(const AdvancedMove &m)
+    {
+        assert(n < MAX_PERFECT_MOVES);
+        moveList[n++] = m;
+    }
+
+    const AdvancedMove &operator[](size_t i) const { return moveList[i]; }
+
+private:
+    AdvancedMove moveList[MAX_PERFECT_MOVES];
+    size_t n {0};
+};
+
 class Sectors
 {
 public:
     static std::map<Wrappers::WID, Wrappers::WSector> sectors;
     static bool created;
 
-    static std::map<Wrappers::WID, Wrappers::WSector> getSectors();
+    // Finds the sector files of the database on the first call. The same map
+    // is returned until release().
+    static std::map<Wrappers::WID, Wrappers::WSector> &getSectors();
 
     static bool hasDatabase();
+
+    // Destroys the sector objects, so that the next getSectors() scans the
+    // database directory again
+    static void release();
 };
 
 class Player
@@ -133,7 +171,8 @@ protected:
 class PerfectPlayer : public Player
 {
 public:
-    std::map<Wrappers::WID, Wrappers::WSector> secs;
+    // Sectors::sectors, which outlives the player
+    std::map<Wrappers::WID, Wrappers::WSector> &secs;
 
     PerfectPlayer();
     virtual ~PerfectPlayer() { }
@@ -142,7 +181,7 @@ public:
 
     void quit() override { Player::quit(); }
 
-    Wrappers::WSector *getSec(const GameState s);
+    Wrappers::WSector *getSec(const GameState &s);
 
     std::string toHumanReadableEval(Wrappers::gui_eval_elem2 e);
 
@@ -152,39 +191,47 @@ public:
 
     bool isMill(const GameState &s, int m);
 
-    std::vector<AdvancedMove> setMoves(const GameState &s);
+    // The generators append the moves of s to r
+    void setMoves(const GameState &s, AdvancedMoveList &r);
 
-    std::vector<AdvancedMove> slideMoves(const GameState &s);
+    void slideMoves(const GameState &s, AdvancedMoveList &r);
 
     // m has a withTaking step, where takeHon is not filled out. This function
-    // creates a list, the elements of which are copies of m supplemented with
-    // one possible removal each.
-    std::vector<AdvancedMove> withTakingMoves(const GameState &s,
-                                              AdvancedMove &m);
+    // appends copies of m supplemented with one possible removal each.
+    void withTakingMoves(const GameState &s, const AdvancedMove &m,
+                         AdvancedMoveList &r);
 
-    std::vector<AdvancedMove> onlyTakingMoves(const GameState &s);
+    void onlyTakingMoves(const GameState &s, AdvancedMoveList &r);
 
-    std::vector<AdvancedMove> getMoveList(const GameState &s);
+    void getMoveList(const GameState &s, AdvancedMoveList &r);
 
-    GameState makeMoveInState(const GameState &s, AdvancedMove &m);
+    GameState makeMoveInState(const GameState &s, const AdvancedMove &m);
 
     // Assuming gui_eval_elem2 and getSec functions are defined somewhere
-    Wrappers::gui_eval_elem2 moveValue(const GameState &s, AdvancedMove &m);
+    Wrappers::gui_eval_elem2 moveValue(const GameState &s,
+                                       const AdvancedMove &m);
 
-    template <typename T, typename K>
-    std::vector<T> allMaxBy(std::function<K(T)> f, const std::vector<T> &l,
-                            K minValue, Value &value);
+    // Writes the values of all the moves in ms to values, in the same order.
+    // The children are grouped by sector, so that each sector is looked up
+    // and probed once.
+    void moveValues(const GameState &s, const AdvancedMoveList &ms,
+                    Wrappers::gui_eval_elem2 *values);
 
-    // Assuming the definition of gui_eval_elem2::min_value function
-    std::vector<AdvancedMove> goodMoves(const GameState &s, Value &value);
+    // Fills r with the elements of l with the best value, values[i] being the
+    // value of l[i]. better(x, y) tells whether value x is strictly better
+    // than value y.
+    template <typename K, typename Better>
+    void allMaxBy(const AdvancedMoveList &l, const K *values, Better better,
+                  AdvancedMoveList &r, Value &value);
 
-    int NGMAfterMove(const GameState &s, AdvancedMove &m);
+    void goodMoves(const GameState &s, Value &value, AdvancedMoveList &r);
 
-    template <typename T>
-    T chooseRandom(const std::vector<T> &l, const Move &refMove)
+    int NGMAfterMove(const GameState &s, const AdvancedMove &m);
+
+    AdvancedMove chooseRandom(const AdvancedMoveList &l, const Move &refMove)
     {
-        static std::random_device rd;
-        static std::mt19937 gen(rd());
+        static thread_local std::random_device rd;
+        static thread_local std::mt19937 gen(rd());
 
         AdvancedMove advMoveRef;
         auto m = refMove;
@@ -247,9 +294,21 @@ out:
         double val;
     };
 
-    Wrappers::gui_eval_elem2 eval(GameState s);
+    Wrappers::gui_eval_elem2 eval(const GameState &s);
+
+    // The value of s like eval(), also for a stone taking position, but only
+    // from resident sectors. Returns false where eval() would read the disk,
+    // or if a sector is missing.
+    bool probe(const GameState &s, Wrappers::gui_eval_elem2 &e);
 
     int64_t boardNegate(int64_t a);
+
+private:
+    // The sector of s and the board of s in it, seen by the side to move
+    Wrappers::WID evalKey(const GameState &s, board &a);
+
+    // probe() of a position without a stone to take
+    bool probeNoTaking(const GameState &s, Wrappers::gui_eval_elem2 &e);
 };
 
 #endif // PERFECT_PLAYER_H_INCLUDED
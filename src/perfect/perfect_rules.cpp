@@ -33,10 +33,12 @@
 uint8_t Rules::millPos[20][3];
 uint8_t Rules::stdLaskerMillPos[16][3];
 int *Rules::stdLaskerInvMillPos[24] = {nullptr};
+size_t Rules::stdLaskerInvMillPosLengths[24];
 bool Rules::stdLaskerBoardGraph[24][24] = {{false}};
 uint8_t Rules::stdLaskerALBoardGraph[24][5] = {{0}};
 uint8_t Rules::moraMillPos[20][3];
 int *Rules::moraInvMillPos[24];
+size_t Rules::moraInvMillPosLengths[24];
 bool Rules::moraBoardGraph[24][24];
 uint8_t Rules::moraALBoardGraph[24][5];
 int *Rules::invMillPos[24];
@@ -90,7 +92,7 @@ void Rules::initRules()
             }
         }
         // Store the length
-        invMillPosLengths[i] = l.size();
+        stdLaskerInvMillPosLengths[i] = l.size();
         // Convert the vector into an array and store it in stdLaskerInvMillPos
         stdLaskerInvMillPos[i] = new int[l.size()];
         for (size_t j = 0; j < l.size(); j++) {
@@ -176,6 +178,7 @@ void Rules::initRules()
                 l.push_back(j);
             }
         }
+        moraInvMillPosLengths[i] = l.size();
         moraInvMillPos[i] = new int[l.size()];
         std::copy(l.begin(), l.end(), moraInvMillPos[i]);
     }
@@ -225,7 +228,7 @@ void Rules::cleanup()
 
 // Returns -1 if there is no mill on the given field, otherwise returns the
 // sequence number in StdLaskerMalomPoz
-int Rules::malome(int m, GameState s)
+int Rules::malome(int m, const GameState &s)
 {
     int result = -1;
     // Use the stored length instead of sizeof
@@ -260,7 +263,7 @@ bool Rules::youCanMove(const GameState &s)
     return false;
 }
 
-bool Rules::mindenEllensegesPieceMalomban(GameState s)
+bool Rules::mindenEllensegesPieceMalomban(const GameState &s)
 {
     for (int i = 0; i <= 23; i++) {
         if (s.T[i] == 1 - s.sideToMove && malome(i, s) == -1)
@@ -288,6 +291,7 @@ void Rules::setVariant()
         std::memcpy(millPos, stdLaskerMillPos, sizeof(stdLaskerMillPos));
         for (int i = 0; i < 24; ++i) {
             invMillPos[i] = stdLaskerInvMillPos[i];
+            invMillPosLengths[i] = stdLaskerInvMillPosLengths[i];
         }
         std::memcpy(boardGraph, stdLaskerBoardGraph,
                     sizeof(stdLaskerBoardGraph));
@@ -299,6 +303,7 @@ void Rules::setVariant()
         std::memcpy(millPos, stdLaskerMillPos, sizeof(stdLaskerMillPos));
         for (int i = 0; i < 24; ++i) {
             invMillPos[i] = stdLaskerInvMillPos[i];
+            invMillPosLengths[i] = stdLaskerInvMillPosLengths[i];
         }
         std::memcpy(boardGraph, stdLaskerBoardGraph,
                     sizeof(stdLaskerBoardGraph));
@@ -310,6 +315,7 @@ void Rules::setVariant()
         std::memcpy(millPos, moraMillPos, sizeof(moraMillPos));
         for (int i = 0; i < 24; ++i) {
             invMillPos[i] = moraInvMillPos[i];
+            invMillPosLengths[i] = moraInvMillPosLengths[i];
         }
         std::memcpy(boardGraph, moraBoardGraph, sizeof(moraBoardGraph));
         std::memcpy(aLBoardGraph, moraALBoardGraph, sizeof(moraALBoardGraph));
@@ -44,7 +44,9 @@ public:
     static int *invMillPos[24];
     static size_t invMillPosLengths[24];
     static int *stdLaskerInvMillPos[24];
+    static size_t stdLaskerInvMillPosLengths[24];
     static int *moraInvMillPos[24];
+    static size_t moraInvMillPosLengths[24];
 
     // Define your boolean arrays
     static bool boardGraph[24][24];
@@ -67,12 +69,12 @@ public:
 
     // Returns -1 if there is no mill on the given field, otherwise returns the
     // sequence number in StdLaskerMalomPoz
-    static int malome(int m, GameState s);
+    static int malome(int m, const GameState &s);
 
     // Tells whether the next player can move '(doesn't handle the kle case)
     static bool youCanMove(const GameState &s);
 
-    static bool mindenEllensegesPieceMalomban(GameState s);
+    static bool mindenEllensegesPieceMalomban(const GameState &s);
 
     // Checking if AlphaBeta is available
     static bool alphaBetaAvailable();
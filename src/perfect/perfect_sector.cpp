@@ -26,7 +26,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "perfect_hash.h"
 #include "perfect_symmetries.h"
 
-#include <chrono>
+#include <algorithm>
+#include <cstring>
 #include <cstdio>
 #include <vector>
 
@@ -46,12 +47,7 @@ Sector::Sector(::Id the_id)
     , max_val(-1)
     , max_count(-1)
     , hash(nullptr)
-#ifdef WRAPPER
-    , f(nullptr)
-    , sval(
-#else
     , sval(
-#endif
 #ifdef DD
           sec_vals[id]
 #else
@@ -71,14 +67,21 @@ Sector::Sector(::Id the_id)
 #endif
 }
 
-template <class T>
-size_t fread1(T &x, FILE *file)
+Sector::~Sector()
 {
-    size_t ret = fread(&x, sizeof(x), 1, file);
-    if (ret != 1) {
-        throw std::runtime_error("fread1 failed");
+    if (hash != nullptr) {
+        release_hash();
     }
-    return ret;
+
+    sector_objs.erase(std::remove(sector_objs.begin(), sector_objs.end(), this),
+                      sector_objs.end());
+}
+
+template <class T>
+const char *read1(T &x, const char *p)
+{
+    std::memcpy(&x, p, sizeof(x));
+    return p + sizeof(x);
 }
 
 template <class T>
@@ -91,114 +94,124 @@ size_t fwrite1(T &x, FILE *file)
     return ret;
 }
 
-void Sector::read_header(FILE *file)
+void Sector::read_header(const char *p)
 {
 #ifdef DD
     int _version, _eval_struct_size, _field2_offset;
     char _stone_diff_flag;
-    fread1(_version, file);
-    fread1(_eval_struct_size, file);
-    fread1(_field2_offset, file);
-    fread1(_stone_diff_flag, file);
+    p = read1(_version, p);
+    p = read1(_eval_struct_size, p);
+    p = read1(_field2_offset, p);
+    read1(_stone_diff_flag, p);
     assert(_version == version);
     assert(_eval_struct_size == eval_struct_size);
     assert(_field2_offset == field2_offset);
     assert(_stone_diff_flag == stone_diff_flag);
-    fseek(f, header_size, SEEK_SET);
+#else
+    (void)p;
 #endif
 }
-void Sector::write_header(FILE *file)
+void Sector::write_header(FILE *out)
 {
 #ifdef DD
-    fwrite1(version, file);
-    fwrite1(eval_struct_size, file);
-    fwrite1(field2_offset, file);
-    fwrite1(stone_diff_flag, file);
-    long ffu_size = header_size - ftell(file);
+    fwrite1(version, out);
+    fwrite1(eval_struct_size, out);
+    fwrite1(field2_offset, out);
+    fwrite1(stone_diff_flag, out);
+    long ffu_size = header_size - ftell(out);
     char *dummy = new char[ffu_size];
     memset(dummy, 0, ffu_size);
-    fwrite(dummy, 1, ffu_size, file);
+    fwrite(dummy, 1, ffu_size, out);
     delete[] dummy;
 #endif
 }
 
-void Sector::read_em_set(FILE *file)
+namespace {
+
+int em_key(const char *table, size_t k)
+{
+    int x;
+    std::memcpy(&x, table + 8 * k, sizeof(x));
+    return x;
+}
+
+int em_value(const char *table, size_t k)
 {
-    auto start = std::chrono::steady_clock::now();
-    auto last_update = std::chrono::steady_clock::now();
+    int x;
+    std::memcpy(&x, table + 8 * k + 4, sizeof(x));
+    return x;
+}
+
+} // namespace
 
+void Sector::read_em_set(const char *p, const char *end)
+{
     int em_set_size = 0;
-    size_t ret = fread(&em_set_size, 4, 1, file);
-    if (ret != 1) {
+    if (end - p < 4) {
         throw std::runtime_error("Failed to read em_set_size");
     }
+    p = read1(em_set_size, p);
 
-    for (int i = 0; i < em_set_size; i++) {
-        int e[2];
-        ret = fread(e, 4, 2, file);
-        if (ret != 2) {
-            throw std::runtime_error("Failed to read array 'e'");
-        }
-        em_set[e[0]] = e[1];
-
-        auto now = std::chrono::steady_clock::now();
-        auto time_since_last_update =
-            std::chrono::duration_cast<std::chrono::seconds>(now - last_update)
-                .count();
-
-        // Only update the console every second
-        if (time_since_last_update >= 1) {
-            // Calculate memory usage
-            float memoryUsageMB = ((i + 1) * 8.0f) / (1024 * 1024); // MB
-
-            // Calculate elapsed time
-            auto elapsed_seconds =
-                std::chrono::duration_cast<std::chrono::seconds>(now - start)
-                    .count();
-            auto hours = elapsed_seconds / 3600;
-            int minutes = (elapsed_seconds % 3600) / 60;
-            int seconds = elapsed_seconds % 60;
-
-            // Calculate remaining time
-            int remaining_iterations = em_set_size - (i + 1);
-            auto avg_seconds_per_iteration = elapsed_seconds / (float)(i + 1);
-            auto remaining_seconds = remaining_iterations *
-                                     avg_seconds_per_iteration;
-            auto remaining_hours = remaining_seconds / 3600;
-            int remaining_minutes = ((unsigned int)remaining_seconds % 3600) /
-                                    60;
-            int remaining_secs = (unsigned int)remaining_seconds % 60;
-
-            if (memoryUsageMB < 1024) {
-                printf("\rProgress: %.2f%%, Memory Usage: %.2fMB, Elapsed "
-                       "time: %02d:%02d:%02d, Remaining time: %02d:%02d:%02d",
-                       ((float)(i + 1) / em_set_size) * 100, memoryUsageMB,
-                       static_cast<int>(hours), static_cast<int>(minutes),
-                       static_cast<int>(seconds),
-                       static_cast<int>(remaining_hours),
-                       static_cast<int>(remaining_minutes),
-                       static_cast<int>(remaining_secs));
-            } else {
-                printf("\rProgress: %.2f%%, Memory Usage: %.2fGB, Elapsed "
-                       "time: %02d:%02d:%02d, Remaining time: %02d:%02d:%02d",
-                       ((float)(i + 1) / em_set_size) * 100,
-                       memoryUsageMB / 1024.0, static_cast<int>(hours),
-                       static_cast<int>(minutes), static_cast<int>(seconds),
-                       static_cast<int>(remaining_hours),
-                       static_cast<int>(remaining_minutes),
-                       static_cast<int>(remaining_secs));
-            }
-
-            // Flush the output buffer to immediately update the output
-            fflush(stdout);
-
-            last_update = now;
-        }
+    if (em_set_size < 0 || (end - p) / 8 < em_set_size) {
+        throw std::runtime_error("Failed to read array 'e'");
     }
 
-    // Print a new line after the loop ends to avoid subsequent outputs
-    // on the same line
-    printf("\n");
+    em_table = p;
+    em_count = static_cast<size_t>(em_set_size);
+
+    // When the file has the table sorted by key, it is searched where it
+    // lies. Otherwise sort a copy, the last entry of a key winning as it did
+    // when the table was loaded into a map.
+    size_t k = 1;
+    while (k < em_count && em_key(p, k - 1) < em_key(p, k))
+        k++;
+    if (k >= em_count)
+        return;
+
+    std::vector<std::pair<int, int>> e(em_count);
+    for (k = 0; k < em_count; k++)
+        e[k] = {em_key(p, k), em_value(p, k)};
+    std::stable_sort(e.begin(), e.end(),
+                     [](const std::pair<int, int> &a,
+                        const std::pair<int, int> &b) {
+                         return a.first < b.first;
+                     });
+
+    em_copy.clear();
+    for (k = 0; k < e.size(); k++) {
+        if (k + 1 < e.size() && e[k + 1].first == e[k].first)
+            continue;
+        em_copy.push_back(e[k].first);
+        em_copy.push_back(e[k].second);
+    }
+    em_table = reinterpret_cast<const char *>(em_copy.data());
+    em_count = em_copy.size() / 2;
+}
+
+int Sector::em_lookup(int i) const
+{
+    // A damaged file can mark a value as an exception without listing it
+    if (em_count == 0) {
+        throw std::runtime_error("Missing exception for index " +
+                                 std::to_string(i) + " in " + fname);
+    }
+
+    // Branchless binary search for the last key not greater than i: the
+    // comparison only selects the next base, so there is nothing to mispredict
+    size_t base = 0;
+    size_t n = em_count;
+    while (n > 1) {
+        const size_t half = n / 2;
+        base = em_key(em_table, base + half) <= i ? base + half : base;
+        n -= half;
+    }
+
+    if (em_key(em_table, base) != i) {
+        throw std::runtime_error("Missing exception for index " +
+                                 std::to_string(i) + " in " + fname);
+    }
+
+    return em_value(em_table, base);
 }
 
 #ifdef DD
@@ -216,8 +229,7 @@ eval_elem_sym2 Sector::get_eval_inner(int i)
 
     std::pair<sec_val, field2_t> resi = extract(i);
     if (resi.second == spec_field2) {
-        assert(em_set.count(i));
-        return eval_elem_sym2 {resi.first, em_set[i]};
+        return eval_elem_sym2 {resi.first, em_lookup(i)};
     } else {
         return eval_elem_sym2 {resi.first, resi.second};
     }
@@ -230,22 +242,17 @@ eval_elem2 Sector::get_eval(int i)
 
 eval_elem_sym2 Sector::get_eval_inner(int i)
 {
-    size_t ret;
 #ifndef WRAPPER
     int resi = eval[i];
 #else
-    fseek(f, i, SEEK_SET);
-    unsigned char read;
-    ret = fread(&read, 1, 1, f);
-    if (ret != 1) {
+    if (static_cast<size_t>(i) >= file.size()) {
         throw std::runtime_error("Failed to read 'read' variable");
     }
-    int resi = read;
+    int resi = static_cast<unsigned char>(file.data()[i]);
 #endif
 
     if (resi == SPEC) {
-        assert(em_set.count(i));
-        int x = em_set[i];
+        int x = em_lookup(i);
         return x >= 0 ? eval_elem_sym(eval_elem_sym::val, x) :
                         eval_elem_sym(eval_elem_sym::count, -x);
     } else {
@@ -284,12 +291,13 @@ std::pair<sec_val, field2_t> Sector::extract(int i)
     for (int j = 0; j < eval_struct_size; j++)
         a |= (int)eval[eval_struct_size * i + j] << 8 * j;
 #else
-    fseek(f, header_size + eval_struct_size * i, SEEK_SET);
-    unsigned char read[eval_struct_size];
-    size_t ret = fread(&read, 1, eval_struct_size, f);
-    if (ret != eval_struct_size) {
+    const size_t offset = header_size +
+                          static_cast<size_t>(eval_struct_size) * i;
+    if (offset + eval_struct_size > file.size()) {
         throw std::runtime_error("Failed to read the expected number of bytes");
     }
+    const auto *read = reinterpret_cast<const unsigned char *>(file.data() +
+                                                               offset);
     for (int j = 0; j < eval_struct_size; j++)
         a |= (int)read[j] << 8 * j;
 #endif
@@ -315,35 +323,51 @@ void Sector::allocate_hash()
 #endif
 
 #ifdef WRAPPER
-    if (!f) {
-        std::string filename = std::string(fname);
+    std::string filename = std::string(fname);
 #ifdef _WIN32
-        filename = sec_val_path + "\\" + filename;
+    filename = sec_val_path + "\\" + filename;
 #else
-        filename = sec_val_path + "/" + filename;
+    filename = sec_val_path + "/" + filename;
 #endif
 
-        if (FOPEN(&f, filename.c_str(), "rb") == -1) {
-            std::cerr << "Failed to open file " << filename << '\n';
-            return;
-        }
-        read_header(f);
+    if (!file.open(filename) ||
+        file.size() < static_cast<size_t>(header_size + eval_size)) {
+        std::cerr << "Failed to open file " << filename << '\n';
+        file.close();
+        return;
     }
-    fseek(f, header_size + eval_size, SEEK_SET);
-    read_em_set(f);
+    read_header(file.data());
+
+    // The values and the exceptions are probed one by one, so reading ahead
+    // around them would only evict other pages
+    file.advise(MappedFile::Advice::Random);
+    read_em_set(file.data() + header_size + eval_size,
+                file.data() + file.size());
 #endif
 }
 
+void Sector::prefetch() const
+{
+    file.advise(MappedFile::Advice::WillNeed, 0, header_size + eval_size);
+}
+
+size_t Sector::memory_usage() const
+{
+    // The exception table lives in the mapping unless it had to be sorted
+    return (hash ? hash->memory_usage() : 0) + em_copy.size() * sizeof(int);
+}
+
 void Sector::release_hash()
 {
     // and clear em_set (should be renamed)
     delete hash;
     hash = nullptr;
 
-    em_set.clear();
+    em_table = nullptr;
+    em_count = 0;
+    std::vector<int>().swap(em_copy);
 
-#ifdef WRAPPER
-    fclose(f);
-    f = nullptr;
-#endif
+    // Mapping the files of all the sectors ever probed could exhaust the
+    // address space of 32-bit builds, so the file goes with the hash
+    file.close();
 }
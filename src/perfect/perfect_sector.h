@@ -29,6 +29,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "perfect_sec_val.h"
 #include "perfect_sector_graph.h"
 
+#include <atomic>
+#include <vector>
+
 #ifndef WRAPPER
 #include "movegen.h"
 #endif
@@ -46,16 +49,25 @@ class Sector
 
     int eval_size;
 
-    std::map<int, int> em_set;
+    // The exception table: em_count (key, value) pairs of ints sorted by key.
+    // It is read in place from the mapping of the file, unless the file is not
+    // sorted, in which case it points into em_copy.
+    const char *em_table {nullptr};
+    size_t em_count {0};
+    std::vector<int> em_copy;
 
 #ifdef DD
     static const int header_size = 64;
 #else
     static const int header_size = 0;
 #endif
-    void read_header(FILE *file);
-    void write_header(FILE *file);
-    void read_em_set(FILE *file);
+    void read_header(const char *p);
+
+    // Reads the exception table starting at p, before end
+    void read_em_set(const char *p, const char *end);
+
+    // Returns the value stored in the exception table for index i
+    int em_lookup(int i) const;
 
 public:
     int W {0};
@@ -65,6 +77,7 @@ public:
     Id id;
 
     Sector(::Id the_id);
+    ~Sector();
 
     eval_elem2 get_eval(int i);
     eval_elem_sym2 get_eval_inner(int i);
@@ -78,11 +91,24 @@ public:
 
     Hash *hash {nullptr};
 
-    FILE *f {nullptr};
+    // When the hash was last used, see WSector::hash()
+    std::atomic<int> last_access {0};
+
+    // The sector file, mapped while the hash is allocated
+    MappedFile file;
 
     void allocate_hash();
     void release_hash();
 
+    // Writes the header of the sector file, which the values follow
+    void write_header(FILE *out);
+
+    // Asks the system to start reading the values of the sector in
+    void prefetch() const;
+
+    // Bytes held while the hash is allocated
+    size_t memory_usage() const;
+
 public:
     sec_val sval;
 };
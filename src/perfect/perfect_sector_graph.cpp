@@ -132,6 +132,18 @@ void init_sector_graph()
 {
     LOG("init_sector_graph %s", ruleVariantName.c_str());
 
+    // Start over if the graph of another variant was built before
+    std::set<wu *> old_wus;
+    for (auto &w : wus)
+        old_wus.insert(w.second);
+    for (wu *w : old_wus)
+        delete w;
+    wus.clear();
+    wu_ids.clear();
+    sector_graph.clear();
+    sector_graph_t.clear();
+    sector_list.clear();
+
     std::queue<Id> q;
     std::set<Id> volt;
 #ifndef FULL_SECTOR_GRAPH
@@ -0,0 +1,782 @@
+// Malom, a Nine Men's Morris (and variants) player and solver program.
+// Copyright(C) 2007-2016  Gabor E. Gevay, Gabor Danner
+// Copyright (C) 2023-2024 The Sanmill developers (see AUTHORS file)
+//
+// See our webpage (and the paper linked from there):
+// http://compalg.inf.elte.hu/~ggevay/mills/index.php
+//
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "perfect_solver.h"
+#include "perfect_common.h"
+#include "perfect_hash.h"
+#include "perfect_rules.h"
+#include "perfect_sec_val.h"
+#include "perfect_sector.h"
+#include "perfect_sector_graph.h"
+#include "perfect_symmetries.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// The value of a position while its work unit is being solved: UNKNOWN, DRAW,
+// or the number of steps to the end of the game plus one. The side to move
+// wins if the number of steps is odd, and loses if it is even.
+using Cell = uint16_t;
+constexpr Cell UNKNOWN = 0;
+constexpr Cell DRAW = 0xFFFF;
+
+// See Job::min_win and Job::max_loss
+constexpr uint16_t NO_BOUND = 0xFFFF;
+
+// Positions per task of a sweep
+constexpr int chunk_size = 1 << 16;
+
+uint32_t adjacent[24];
+uint32_t mills_at[24][4];
+int mill_count_at[24];
+
+void init_move_tables()
+{
+    const int mill_count = ruleVariant == MORABARABA ? 20 : 16;
+
+    for (int i = 0; i < 24; i++) {
+        adjacent[i] = 0;
+        for (int j = 0; j < 24; j++)
+            if (Rules::boardGraph[i][j])
+                adjacent[i] |= 1u << j;
+        mill_count_at[i] = 0;
+    }
+
+    for (int m = 0; m < mill_count; m++) {
+        uint32_t mask = 0;
+        for (int k = 0; k < 3; k++)
+            mask |= 1u << Rules::millPos[m][k];
+        for (int k = 0; k < 3; k++) {
+            const int sq = Rules::millPos[m][k];
+            mills_at[sq][mill_count_at[sq]++] = mask;
+        }
+    }
+}
+
+bool in_mill(uint32_t stones, int sq)
+{
+    for (int k = 0; k < mill_count_at[sq]; k++)
+        if ((stones & mills_at[sq][k]) == mills_at[sq][k])
+            return true;
+    return false;
+}
+
+// The stones which may be removed: those not in a mill, or all of them if
+// every one is in a mill
+uint32_t removable(uint32_t stones)
+{
+    uint32_t r = 0;
+    for (uint32_t s = stones; s; s &= s - 1)
+        if (!in_mill(stones, CTZ(s)))
+            r |= s & (0u - s);
+    return r ? r : stones;
+}
+
+// Whether a position of u without moves is a draw rather than a loss: the
+// board is full and the rule calls that a draw, as GameState does
+bool blocked_is_draw(const Id &u)
+{
+    return rule.boardFullAction == BoardFullAction::agreeToDraw &&
+           u.W == 12 && u.B == 12;
+}
+
+enum class Kind { Internal, External, Win };
+
+// Calls f(kind, id, a) for each move of the position a of sector u, with the
+// sector and the position after the move, from the viewpoint of the opponent.
+// The moves are those of PerfectPlayer::getMoveList(), and a move which closes
+// a mill comes with each possible removal. Internal children are in -u, which
+// is usually in the work unit of u. Win is a move which leaves the opponent
+// with fewer than three stones, f gets no position for it. With
+// internal_only, only the internal children are generated.
+template <class F>
+void for_each_child(const Id &u, board a, bool internal_only, F &&f)
+{
+    const auto us = static_cast<uint32_t>(a & mask24);
+    const auto them = static_cast<uint32_t>(a >> 24);
+    const uint32_t empty = ~(us | them) & mask24;
+
+    auto move = [&](uint32_t after, int to, bool placed) {
+        const int w = placed ? u.W + 1 : u.W;
+        const int wf = placed ? u.WF - 1 : u.WF;
+
+        if (!in_mill(after, to)) {
+            f(placed ? Kind::External : Kind::Internal, Id(u.B, w, u.BF, wf),
+              them | static_cast<board>(after) << 24);
+            return;
+        }
+
+        // Without a stone to remove, the move is not possible
+        if (internal_only || them == 0)
+            return;
+
+        if (u.B - 1 + u.BF < 3) {
+            f(Kind::Win, Id::null(), board {0});
+            return;
+        }
+
+        const Id id(u.B - 1, w, u.BF, wf);
+        for (uint32_t r = removable(them); r; r &= r - 1) {
+            f(Kind::External, id,
+              (them ^ (r & (0u - r))) | static_cast<board>(after) << 24);
+        }
+    };
+
+    if (u.WF > 0 && !internal_only) {
+        for (uint32_t e = empty; e; e &= e - 1)
+            move(us | (e & (0u - e)), CTZ(e), true);
+    }
+
+    if (u.WF == 0 || ruleVariant == LASKER) {
+        const bool fly = u.W + u.WF == 3;
+        for (uint32_t s = us; s; s &= s - 1) {
+            const int from = CTZ(s);
+            const uint32_t rest = us ^ (1u << from);
+            for (uint32_t t = fly ? empty : adjacent[from] & empty; t;
+                 t &= t - 1)
+                move(rest | (t & (0u - t)), CTZ(t), false);
+        }
+    }
+}
+
+std::string sector_path(Id id)
+{
+#ifdef _WIN32
+    return sec_val_path + "\\" + id.file_name();
+#else
+    return sec_val_path + "/" + id.file_name();
+#endif
+}
+
+// A sector of the work unit being solved
+struct Job
+{
+    Id id;
+    Sector *sector {nullptr}; // Reads the values back once they are written
+    std::unique_ptr<Hash> hash; // Indexes the positions
+    Job *negation {nullptr};    // The sector of the internal children, if any
+
+    // Whether the negation is solved with this sector. Otherwise it is
+    // solved before, like the sectors of the external children.
+    bool same_unit {false};
+    bool solved {false};
+
+    std::vector<Cell> cells;
+
+    // What the external children give to the positions which also have
+    // internal ones: the smallest number of steps of a win, and the largest
+    // of a loss. NO_BOUND if there is no win, or if the position cannot be a
+    // loss because an external child does not win.
+    std::vector<uint16_t> min_win, max_loss;
+
+    ~Job() { delete sector; }
+};
+
+// A work unit of the sector graph: a sector, and its negation if they have
+// moves into each other
+struct Unit
+{
+    Job *jobs[2] {nullptr, nullptr};
+    int job_count {0};
+    std::vector<Unit *> parents;
+    int waiting {0}; // Child units not solved yet
+
+    struct Chunk
+    {
+        Job *job;
+        int begin, end;
+        std::vector<std::pair<int, Cell>> updates;
+        int max_steps;
+    };
+    std::vector<Chunk> chunks;
+    std::atomic<int> pending {0};
+
+    // The number of steps the current sweep resolves, 0 for the first one
+    int steps {0};
+    int last_change {0};
+
+    // No value of an external child, nor of a position the first sweep
+    // resolved, has more steps than this
+    int max_steps {0};
+
+    size_t unknown {0};
+    std::chrono::steady_clock::time_point start;
+};
+
+class Solver
+{
+public:
+    explicit Solver(int threads)
+        : thread_count(std::max(threads, 1))
+    { }
+
+    bool run();
+
+private:
+    void schedule(Unit *u);
+    void begin(Unit *u);
+    void post_sweep(Unit *u);
+    void first_sweep(Unit::Chunk &c);
+    void step_sweep(Unit *u, Unit::Chunk &c);
+    void end_sweep(Unit *u);
+    void finish(Unit *u);
+    void write(const Job &job);
+    Job &job_of(const Id &id);
+    void worker();
+
+    int thread_count;
+    std::map<Id, std::unique_ptr<Job>> jobs;
+    std::vector<std::unique_ptr<Unit>> units;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::queue<std::function<void()>> tasks;
+    size_t solved_units {0};
+    size_t running_units {0}; // Scheduled and not finished yet
+    bool stopped {false};
+    std::string error;
+};
+
+Job &Solver::job_of(const Id &id)
+{
+    auto it = jobs.find(id);
+    if (it == jobs.end()) {
+        throw std::runtime_error("Sector " + Id(id).to_string() +
+                                 " is not in the sector graph");
+    }
+    return *it->second;
+}
+
+bool Solver::run()
+{
+    init_move_tables();
+
+    for (const Id &id : sector_list) {
+        auto job = std::make_unique<Job>();
+        job->id = id;
+        job->sector = new Sector(id);
+        job->hash = std::make_unique<Hash>(id.W, id.B, job->sector);
+
+        // Keep the sectors solved by an earlier run
+        if (std::ifstream(sector_path(id)).good()) {
+            job->sector->allocate_hash();
+            job->solved = job->sector->file.is_open();
+            if (!job->solved)
+                job->sector->release_hash();
+        }
+
+        jobs.emplace(id, std::move(job));
+    }
+
+    std::map<wu *, Unit *> unit_of;
+    for (const Id &id : wu_ids) {
+        wu *w = wus[id];
+        auto u = std::make_unique<Unit>();
+        u->jobs[u->job_count++] = &job_of(id);
+        if (w->twine)
+            u->jobs[u->job_count++] = &job_of(-id);
+        for (int k = 0; k < u->job_count; k++) {
+            Job &job = *u->jobs[k];
+            // Only the sectors which slide have internal children
+            auto it = jobs.find(-job.id);
+            job.negation = it != jobs.end() ? it->second.get() : nullptr;
+            job.same_unit = job.negation &&
+                            (job.negation == u->jobs[0] ||
+                             job.negation == u->jobs[1]);
+        }
+        unit_of[w] = u.get();
+        units.push_back(std::move(u));
+    }
+
+    for (auto &[w, u] : unit_of) {
+        for (wu *p : w->parents)
+            u->parents.push_back(unit_of.at(p));
+    }
+
+    for (auto &[w, u] : unit_of) {
+        for (Unit *p : u->parents)
+            p->waiting++;
+    }
+
+    std::vector<Unit *> ready;
+    for (auto &u : units) {
+        bool solved = true;
+        for (int k = 0; k < u->job_count; k++)
+            solved = solved && u->jobs[k]->solved;
+        if (!solved)
+            continue;
+
+        solved_units++;
+        for (Unit *p : u->parents)
+            p->waiting--;
+    }
+    for (auto &u : units) {
+        bool solved = true;
+        for (int k = 0; k < u->job_count; k++)
+            solved = solved && u->jobs[k]->solved;
+        if (!solved && u->waiting == 0)
+            ready.push_back(u.get());
+    }
+
+    LOG("Solving %d of %d work units of %s with %d threads\n",
+        static_cast<int>(units.size() - solved_units),
+        static_cast<int>(units.size()), ruleVariantName.c_str(),
+        thread_count);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // With no unit to start from, either everything is solved or the
+        // units left wait on each other
+        stopped = ready.empty();
+        for (Unit *u : ready)
+            schedule(u);
+    }
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count && !stopped; i++)
+        threads.emplace_back([this] { worker(); });
+    for (auto &t : threads)
+        t.join();
+
+    if (!error.empty()) {
+        std::cerr << "Failed to solve " << ruleVariantName << ": " << error
+                  << std::endl;
+        return false;
+    }
+
+    if (solved_units != units.size()) {
+        std::cerr << "Failed to solve " << ruleVariantName
+                  << ": the sector graph has a cycle" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void Solver::worker()
+{
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this] { return stopped || !tasks.empty(); });
+            if (stopped)
+                return;
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+
+        try {
+            task();
+        } catch (const std::exception &e) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (error.empty())
+                error = e.what();
+            stopped = true;
+            cv.notify_all();
+        }
+    }
+}
+
+// Called with the mutex held
+void Solver::schedule(Unit *u)
+{
+    running_units++;
+    tasks.push([this, u] { begin(u); });
+    cv.notify_one();
+}
+
+void Solver::begin(Unit *u)
+{
+    u->start = std::chrono::steady_clock::now();
+    u->chunks.clear();
+
+    for (int k = 0; k < u->job_count; k++) {
+        Job &job = *u->jobs[k];
+        const int n = job.hash->hash_count;
+        job.cells.assign(n, UNKNOWN);
+        job.min_win.assign(n, NO_BOUND);
+        job.max_loss.assign(n, NO_BOUND);
+
+        for (int i = 0; i < n; i += chunk_size) {
+            u->chunks.push_back(
+                Unit::Chunk {&job, i, std::min(i + chunk_size, n), {}, 0});
+        }
+    }
+
+    u->steps = 0;
+    u->last_change = 0;
+    post_sweep(u);
+}
+
+void Solver::post_sweep(Unit *u)
+{
+    if (u->chunks.empty()) {
+        end_sweep(u);
+        return;
+    }
+
+    u->pending = static_cast<int>(u->chunks.size());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &c : u->chunks) {
+        tasks.push([this, u, &c] {
+            if (u->steps == 0)
+                first_sweep(c);
+            else
+                step_sweep(u, c);
+
+            if (--u->pending == 0)
+                end_sweep(u);
+        });
+    }
+    cv.notify_all();
+}
+
+// Resolves the positions whose value does not depend on the work unit itself,
+// and bounds the value of the others
+void Solver::first_sweep(Unit::Chunk &c)
+{
+    Job &job = *c.job;
+
+    // The few sectors the moves of this one lead to
+    std::pair<Id, Job *> children[8];
+    int child_count = 0;
+    auto child_job = [&](const Id &id) -> Job & {
+        for (int k = 0; k < child_count; k++)
+            if (children[k].first == id)
+                return *children[k].second;
+        Job &j = job_of(id);
+        if (child_count < 8)
+            children[child_count++] = {id, &j};
+        return j;
+    };
+
+    c.max_steps = 0;
+
+    for (int i = c.begin; i < c.end; i++) {
+        const board a = job.hash->inv_hash(i);
+        assert(job.hash->index(a) == i);
+
+        int win = NO_BOUND, loss = 0;
+        bool can_lose = true, internal = false, moves = false;
+
+        for_each_child(job.id, a, false,
+                       [&](Kind kind, const Id &id, board child) {
+                           moves = true;
+                           if (kind == Kind::Win) {
+                               win = 1;
+                           } else if (kind == Kind::Internal &&
+                                      job.same_unit) {
+                               internal = true;
+                           } else {
+                               const Sector *s = child_job(id).sector;
+                               const eval_elem2 e = s->hash->hash(child).second;
+                               const int akey1 = e.key1 + s->sval;
+                               if (akey1 == virt_loss_val) {
+                                   win = std::min(win, e.key2 + 1);
+                                   can_lose = false;
+                               } else if (akey1 == virt_win_val) {
+                                   loss = std::max(loss, e.key2 + 1);
+                               } else {
+                                   can_lose = false;
+                               }
+                           }
+                       });
+
+        // A position without moves is lost in 0 steps, or drawn
+        Cell cell = UNKNOWN;
+        if (!moves && blocked_is_draw(job.id))
+            cell = DRAW;
+        else if (win == 1 || (win != NO_BOUND && !internal))
+            cell = static_cast<Cell>(win + 1);
+        else if (!internal)
+            cell = can_lose ? static_cast<Cell>(loss + 1) : DRAW;
+
+        job.cells[i] = cell;
+        if (cell != UNKNOWN) {
+            if (cell != DRAW)
+                c.max_steps = std::max(c.max_steps, cell - 1);
+            continue;
+        }
+
+        job.min_win[i] = static_cast<uint16_t>(win);
+        job.max_loss[i] = can_lose ? static_cast<uint16_t>(loss) : NO_BOUND;
+        if (win != NO_BOUND)
+            c.max_steps = std::max(c.max_steps, win);
+        if (can_lose)
+            c.max_steps = std::max(c.max_steps, loss);
+    }
+}
+
+// Resolves the positions which win or lose in u->steps steps. The cells are
+// only read here, so that every chunk sees the state of the previous sweep.
+void Solver::step_sweep(Unit *u, Unit::Chunk &c)
+{
+    Job &job = *c.job;
+    const Job &other = *job.negation;
+    const int steps = u->steps;
+
+    for (int i = c.begin; i < c.end; i++) {
+        if (job.cells[i] != UNKNOWN)
+            continue;
+
+        int win = job.min_win[i];
+        bool can_lose = job.max_loss[i] != NO_BOUND;
+        int loss = can_lose ? job.max_loss[i] : 0;
+
+        for_each_child(job.id, job.hash->inv_hash(i), true,
+                       [&](Kind, const Id &, board child) {
+                           const Cell v = other.cells[other.hash->index(child)];
+                           if (v == UNKNOWN || v == DRAW) {
+                               can_lose = false;
+                           } else if ((v - 1) % 2 == 0) {
+                               win = std::min(win, int {v});
+                               can_lose = false;
+                           } else {
+                               loss = std::max(loss, int {v});
+                           }
+                       });
+
+        // A value with fewer steps would have been resolved by an earlier
+        // sweep
+        if (win == steps || (can_lose && loss == steps))
+            c.updates.emplace_back(i, static_cast<Cell>(steps + 1));
+    }
+}
+
+void Solver::end_sweep(Unit *u)
+{
+    if (u->steps == 0) {
+        u->max_steps = 0;
+        u->unknown = 0;
+        for (auto &c : u->chunks)
+            u->max_steps = std::max(u->max_steps, c.max_steps);
+        for (int k = 0; k < u->job_count; k++) {
+            const Job &job = *u->jobs[k];
+            u->unknown += std::count(job.cells.begin(), job.cells.end(),
+                                     UNKNOWN);
+        }
+    } else {
+        for (auto &c : u->chunks) {
+            for (const auto &[i, cell] : c.updates)
+                c.job->cells[i] = cell;
+            if (!c.updates.empty())
+                u->last_change = u->steps;
+            u->unknown -= c.updates.size();
+            c.updates.clear();
+        }
+    }
+
+    // Beyond max_steps, a sweep can only resolve positions whose children the
+    // previous sweep resolved
+    if (u->unknown == 0 ||
+        (u->steps > u->max_steps && u->last_change != u->steps)) {
+        finish(u);
+        return;
+    }
+
+    u->steps++;
+    post_sweep(u);
+}
+
+void Solver::finish(Unit *u)
+{
+    size_t positions = 0;
+    for (int k = 0; k < u->job_count; k++) {
+        Job &job = *u->jobs[k];
+        std::replace(job.cells.begin(), job.cells.end(), UNKNOWN, DRAW);
+        std::vector<uint16_t>().swap(job.min_win);
+        std::vector<uint16_t>().swap(job.max_loss);
+        write(job);
+        positions += job.cells.size();
+    }
+
+    const double seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - u->start)
+                               .count();
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Map the files for the parents, and keep the hash tables of the work
+    // units still being solved away from concurrent construction
+    for (int k = 0; k < u->job_count; k++) {
+        Job &job = *u->jobs[k];
+        std::vector<Cell>().swap(job.cells);
+        job.sector->allocate_hash();
+        if (!job.sector->file.is_open()) {
+            throw std::runtime_error("Failed to read back " +
+                                     job.id.file_name());
+        }
+        job.solved = true;
+    }
+
+    LOG("Solved %s%s: %zu positions, %d sweeps, %.1f s\n",
+        u->jobs[0]->id.to_string().c_str(), u->job_count == 2 ? " (twin)" : "",
+        positions, u->steps + 1, seconds);
+
+    running_units--;
+    for (Unit *p : u->parents) {
+        if (--p->waiting == 0)
+            schedule(p);
+    }
+
+    // When the last running unit schedules no parent, the units left wait on
+    // each other and no worker would ever wake up
+    if (++solved_units == units.size() || running_units == 0) {
+        stopped = true;
+        cv.notify_all();
+    }
+}
+
+// Writes the values in the format of Sector::get_eval_inner(). The file is
+// renamed into place once it is complete.
+void Solver::write(const Job &job)
+{
+    const std::string filename = sector_path(job.id);
+    const std::string tmp = filename + ".tmp";
+
+    FILE *f = nullptr;
+    if (FOPEN(&f, tmp.c_str(), "wb") != 0 || f == nullptr)
+        throw std::runtime_error("Failed to create " + tmp);
+
+    job.sector->write_header(f);
+
+    const int spec_field2 = -(1 << (field2_size - 1));
+    const int max_field2 = -(spec_field2 + 1);
+
+    std::vector<unsigned char> values(job.cells.size() * eval_struct_size);
+    std::vector<int> em;
+
+    for (size_t i = 0; i < job.cells.size(); i++) {
+        const Cell cell = job.cells[i];
+        int key1 = 0, key2 = 0;
+        if (cell != DRAW) {
+            key2 = cell - 1;
+            key1 = key2 % 2 ? virt_win_val : virt_loss_val;
+        }
+        key1 -= job.sector->sval;
+
+        int field2 = key2;
+        if (key2 > max_field2) {
+            em.push_back(static_cast<int>(i));
+            em.push_back(key2);
+            field2 = spec_field2;
+        }
+
+        const int x = (key1 & ((1 << field1_size) - 1)) |
+                      (field2 & ((1 << field2_size) - 1)) << field2_offset;
+        for (int j = 0; j < eval_struct_size; j++)
+            values[i * eval_struct_size + j] = static_cast<unsigned char>(
+                x >> 8 * j);
+    }
+
+    // The exceptions are in index order, see Sector::read_em_set()
+    const int em_count = static_cast<int>(em.size() / 2);
+    fwrite(values.data(), 1, values.size(), f);
+    fwrite(&em_count, sizeof(em_count), 1, f);
+    fwrite(em.data(), sizeof(int), em.size(), f);
+
+    const bool failed = ferror(f) != 0;
+    if (fclose(f) != 0 || failed)
+        throw std::runtime_error("Failed to write " + tmp);
+
+    std::remove(filename.c_str());
+    if (std::rename(tmp.c_str(), filename.c_str()) != 0)
+        throw std::runtime_error("Failed to rename " + tmp);
+}
+
+// Writes a .secval file with the value 0 for every sector, unless there is one
+void write_sec_vals()
+{
+#ifdef _WIN32
+    const std::string filename = sec_val_path + "\\" + ruleVariantName +
+                                 ".secval";
+#else
+    const std::string filename = sec_val_path + "/" + ruleVariantName +
+                                 ".secval";
+#endif
+    if (std::ifstream(filename).good())
+        return;
+
+    FILE *f = nullptr;
+    if (FOPEN(&f, filename.c_str(), "wt") != 0 || f == nullptr)
+        throw std::runtime_error("Failed to create " + filename);
+
+    fprintf(f, "virt_loss_val: %d\nvirt_win_val: %d\n%d\n", -1, 1,
+            static_cast<int>(sector_list.size()));
+    for (const Id &id : sector_list)
+        fprintf(f, "%d %d %d %d  %d\n", id.W, id.B, id.WF, id.BF, 0);
+
+    if (fclose(f) != 0)
+        throw std::runtime_error("Failed to write " + filename);
+}
+
+} // namespace
+
+bool solve_database(const std::string &path, int threads)
+{
+    sec_val_path = path;
+
+    Rules::initRules();
+    Rules::setVariant();
+
+    bool ok = false;
+    try {
+        init_sym_lookuptables();
+        init_sector_graph();
+        write_sec_vals();
+        init_sec_vals();
+
+        Solver solver(threads);
+        ok = solver.run();
+    } catch (const std::exception &e) {
+        std::cerr << "Failed to solve " << ruleVariantName << ": " << e.what()
+                  << std::endl;
+    }
+
+    HashTables::release();
+    sec_vals.clear();
+    inv_sec_vals.clear();
+    Rules::cleanup();
+
+    return ok;
+}
@@ -0,0 +1,41 @@
+// Malom, a Nine Men's Morris (and variants) player and solver program.
+// Copyright(C) 2007-2016  Gabor E. Gevay, Gabor Danner
+// Copyright (C) 2023-2024 The Sanmill developers (see AUTHORS file)
+//
+// See our webpage (and the paper linked from there):
+// http://compalg.inf.elte.hu/~ggevay/mills/index.php
+//
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PERFECT_SOLVER_H_INCLUDED
+#define PERFECT_SOLVER_H_INCLUDED
+
+#include <string>
+
+// Solves the sectors of the rule variant selected by perfect_init() by
+// retrograde analysis, and writes them with the .secval file to path, in the
+// format the player reads.
+//
+// The work units of the sector graph are solved in dependency order, those
+// which do not depend on each other at the same time. The positions of a work
+// unit are solved by parallel sweeps, one for each distance to the end of the
+// game. The values are wins and losses with their distances, and draws: every
+// sector value is 0 (NTESC), unless the .secval file already exists.
+//
+// Sectors whose file already exists are kept, so an interrupted run can be
+// resumed. Returns false and prints the reason on failure.
+bool solve_database(const std::string &path, int threads);
+
+#endif // PERFECT_SOLVER_H_INCLUDED
@@ -0,0 +1,460 @@
+// Malom, a Nine Men's Morris (and variants) player and solver program.
+// Copyright(C) 2007-2016  Gabor E. Gevay, Gabor Danner
+// Copyright (C) 2023-2024 The Sanmill developers (see AUTHORS file)
+//
+// See our webpage (and the paper linked from there):
+// http://compalg.inf.elte.hu/~ggevay/mills/index.php
+//
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "perfect_verifier.h"
+#include "perfect_api.h"
+#include "perfect_common.h"
+#include "perfect_game_state.h"
+#include "perfect_player.h"
+#include "perfect_rules.h"
+#include "perfect_sector_graph.h"
+#include "perfect_wrappers.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Positions per task
+constexpr int chunk_size = 1 << 14;
+
+// The ranges of wrong values printed for a sector
+constexpr size_t max_printed_ranges = 8;
+
+// What the check of some positions found
+struct Tally
+{
+    int64_t wins {0};
+    int64_t losses {0};
+    int64_t draws {0};
+
+    // The number of wins and losses by distance
+    std::vector<int64_t> win_steps;
+    std::vector<int64_t> loss_steps;
+
+    // The positions whose value is wrong, as [first, last] ranges
+    std::vector<std::pair<int, int>> wrong;
+
+    void count(const Wrappers::gui_eval_elem2 &e)
+    {
+        const int outcome = e.outcome();
+        if (outcome == 0) {
+            draws++;
+            return;
+        }
+
+        auto &steps = outcome > 0 ? win_steps : loss_steps;
+        (outcome > 0 ? wins : losses)++;
+        if (steps.size() <= static_cast<size_t>(e.steps()))
+            steps.resize(e.steps() + 1);
+        steps[e.steps()]++;
+    }
+
+    void add_wrong(int i)
+    {
+        if (!wrong.empty() && wrong.back().second == i - 1)
+            wrong.back().second = i;
+        else
+            wrong.emplace_back(i, i);
+    }
+
+    void add(const Tally &o)
+    {
+        wins += o.wins;
+        losses += o.losses;
+        draws += o.draws;
+        add_steps(win_steps, o.win_steps);
+        add_steps(loss_steps, o.loss_steps);
+        wrong.insert(wrong.end(), o.wrong.begin(), o.wrong.end());
+    }
+
+    static void add_steps(std::vector<int64_t> &to,
+                          const std::vector<int64_t> &from)
+    {
+        if (to.size() < from.size())
+            to.resize(from.size());
+        for (size_t i = 0; i < from.size(); i++)
+            to[i] += from[i];
+    }
+};
+
+// A sector being checked
+struct Report
+{
+    Id id;
+    Wrappers::WSector *sector {nullptr};
+    int size {0};
+
+    uint64_t checksum {0};
+    Tally tally;
+    std::string error;
+
+    // The tasks not finished yet, guarded by the mutex of the verifier
+    int pending {0};
+};
+
+// A chunk of the positions of a sector, or the checksum of its file if first
+// is -1
+struct Task
+{
+    Report *report;
+    int first;
+};
+
+std::string sector_path(Id id)
+{
+#ifdef _WIN32
+    return sec_val_path + "\\" + id.file_name();
+#else
+    return sec_val_path + "/" + id.file_name();
+#endif
+}
+
+// FNV-1a of the sector file, to compare with the one of a good copy
+uint64_t file_checksum(Id id)
+{
+    MappedFile file;
+    if (!file.open(sector_path(id)))
+        throw std::runtime_error("Failed to map " + id.file_name());
+    file.advise(MappedFile::Advice::Sequential);
+
+    uint64_t h = 14695981039346656037ull;
+    const auto *p = reinterpret_cast<const unsigned char *>(file.data());
+    for (size_t i = 0; i < file.size(); i++)
+        h = (h ^ p[i]) * 1099511628211ull;
+
+    return h;
+}
+
+// The position a of sector id, with white to move
+GameState state_of(const Id &id, board a)
+{
+    GameState s;
+
+    for (int i = 0; i < 24; i++) {
+        if (a & (board {1} << i))
+            s.T[i] = 0;
+        else if (a & (board {1} << (i + 24)))
+            s.T[i] = 1;
+    }
+
+    s.stoneCount = {id.W, id.B};
+    s.setStoneCount = {Rules::maxKSZ - id.WF, Rules::maxKSZ - id.BF};
+    s.phase = id.WF == 0 && id.BF == 0 ? 2 : 1;
+    s.moveCount = 10;
+
+    return s;
+}
+
+class Verifier
+{
+public:
+    explicit Verifier(int threads)
+        : thread_count(std::max(threads, 1))
+    { }
+
+    bool run();
+
+private:
+    void worker();
+    void check(const Report &r, int first, Tally &t);
+    void finish(Report &r);
+
+    const int thread_count;
+    PerfectPlayer pp;
+
+    std::vector<std::unique_ptr<Report>> reports;
+    std::vector<Task> tasks;
+    std::atomic<size_t> next_task {0};
+
+    std::mutex mutex;
+    Tally total;
+    int64_t wrong_values {0};
+    int failed_sectors {0};
+
+    // Per thread buffers of check()
+    static thread_local std::vector<board> boards;
+    static thread_local std::vector<Wrappers::gui_eval_elem2> stored;
+};
+
+thread_local std::vector<board> Verifier::boards;
+thread_local std::vector<Wrappers::gui_eval_elem2> Verifier::stored;
+
+bool Verifier::run()
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    std::set<Id> readable;
+    int problems = 0;
+
+    for (auto &[wid, sector] : pp.secs) {
+        auto r = std::make_unique<Report>();
+        r->id = Wrappers::WID(wid).tonat();
+        r->sector = &sector;
+        r->size = sector.size();
+
+        if (r->size < 0) {
+            LOG("%s: cannot be read\n", r->id.file_name().c_str());
+            problems++;
+            continue;
+        }
+
+        readable.insert(r->id);
+        reports.push_back(std::move(r));
+    }
+
+    for (Id id : sector_list) {
+        if (pp.secs.count(Wrappers::WID(id)) == 0) {
+            LOG("%s: missing\n", id.file_name().c_str());
+            problems++;
+        }
+    }
+
+    // The values of a sector are only checked if the sectors of its moves are
+    // there
+    auto unchecked = std::remove_if(
+        reports.begin(), reports.end(), [&](const std::unique_ptr<Report> &r) {
+            for (Id child : graph_func(r->id)) {
+                if (readable.count(child) == 0) {
+                    LOG("%s: not checked, it needs %s\n",
+                        r->id.file_name().c_str(), child.file_name().c_str());
+                    return true;
+                }
+            }
+            return false;
+        });
+    problems += static_cast<int>(reports.end() - unchecked);
+    reports.erase(unchecked, reports.end());
+
+    int64_t positions = 0;
+    for (auto &r : reports) {
+        tasks.push_back(Task {r.get(), -1});
+        for (int first = 0; first < r->size; first += chunk_size)
+            tasks.push_back(Task {r.get(), first});
+        r->pending = 1 + (r->size + chunk_size - 1) / chunk_size;
+        positions += r->size;
+    }
+
+    LOG("Checking %d sectors of %s with %d threads\n",
+        static_cast<int>(reports.size()), ruleVariantName.c_str(),
+        thread_count);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; i++)
+        threads.emplace_back([this] { worker(); });
+    for (auto &t : threads)
+        t.join();
+
+    const double seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+
+    LOG("Checked %d sectors, %lld positions in %.1f s: %lld wrong values, %d "
+        "sectors failed, %d sectors missing or not checked\n",
+        static_cast<int>(reports.size()), static_cast<long long>(positions),
+        seconds, static_cast<long long>(wrong_values), failed_sectors,
+        problems);
+    LOG("Wins %lld, losses %lld, draws %lld\n",
+        static_cast<long long>(total.wins),
+        static_cast<long long>(total.losses),
+        static_cast<long long>(total.draws));
+
+    LOG("Steps          Wins        Losses\n");
+    const size_t rows = std::max(total.win_steps.size(),
+                                 total.loss_steps.size());
+    total.win_steps.resize(rows);
+    total.loss_steps.resize(rows);
+    for (size_t i = 0; i < rows; i++) {
+        if (total.win_steps[i] == 0 && total.loss_steps[i] == 0)
+            continue;
+        LOG("%5d %13lld %13lld\n", static_cast<int>(i),
+            static_cast<long long>(total.win_steps[i]),
+            static_cast<long long>(total.loss_steps[i]));
+    }
+
+    return wrong_values == 0 && failed_sectors == 0 && problems == 0;
+}
+
+void Verifier::worker()
+{
+    boards.resize(chunk_size);
+    stored.resize(chunk_size);
+
+    for (;;) {
+        const size_t i = next_task++;
+        if (i >= tasks.size())
+            return;
+
+        Report &r = *tasks[i].report;
+        const int first = tasks[i].first;
+
+        Tally t;
+        uint64_t checksum = 0;
+        std::string error;
+        try {
+            if (first < 0)
+                checksum = file_checksum(r.id);
+            else
+                check(r, first, t);
+        } catch (const std::exception &e) {
+            error = e.what();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (first < 0)
+            r.checksum = checksum;
+        r.tally.add(t);
+        if (r.error.empty())
+            r.error = error;
+
+        if (--r.pending == 0)
+            finish(r);
+    }
+}
+
+// Compares the values of the positions first, ... of r with the best values
+// of their moves
+void Verifier::check(const Report &r, int first, Tally &t)
+{
+    const int n = std::min(chunk_size, r.size - first);
+    r.sector->invHash(first, n, boards.data());
+    r.sector->hash(boards.data(), n, stored.data());
+
+    // The value of a position without moves: lost, unless the board is full
+    // and the rule calls that a draw, as GameState does
+    const bool blocked_draw = rule.boardFullAction ==
+                                  BoardFullAction::agreeToDraw &&
+                              r.id.W == 12 && r.id.B == 12;
+    const Wrappers::gui_eval_elem2 blocked {
+        static_cast<sec_val>((blocked_draw ? 0 : ::virt_loss_val) -
+                             r.sector->sval()),
+        0, r.sector->s};
+
+    AdvancedMoveList moves;
+    Wrappers::gui_eval_elem2 values[MAX_PERFECT_MOVES];
+
+    for (int k = 0; k < n; k++) {
+        const GameState s = state_of(r.id, boards[k]);
+
+        pp.getMoveList(s, moves);
+
+        Wrappers::gui_eval_elem2 best = blocked;
+        if (!moves.empty()) {
+            pp.moveValues(s, moves, values);
+            best = *std::max_element(values, values + moves.size());
+        }
+
+        if (!(stored[k] == best))
+            t.add_wrong(first + k);
+        t.count(stored[k]);
+    }
+}
+
+// Prints the report of a sector whose tasks are all done, with the mutex held
+void Verifier::finish(Report &r)
+{
+    auto &wrong = r.tally.wrong;
+    std::sort(wrong.begin(), wrong.end());
+
+    // The chunks add their ranges separately
+    std::vector<std::pair<int, int>> merged;
+    int64_t wrong_count = 0;
+    for (const auto &range : wrong) {
+        if (!merged.empty() && merged.back().second == range.first - 1)
+            merged.back().second = range.second;
+        else
+            merged.push_back(range);
+        wrong_count += range.second - range.first + 1;
+    }
+    wrong.swap(merged);
+
+    std::ostringstream line;
+    line << r.id.file_name() << ": " << r.size << " positions, checksum "
+         << std::hex << std::setw(16) << std::setfill('0') << r.checksum
+         << std::dec << ", " << r.tally.wins << " wins, " << r.tally.losses
+         << " losses, " << r.tally.draws << " draws";
+
+    if (!r.error.empty()) {
+        line << ", failed: " << r.error;
+        failed_sectors++;
+    } else if (wrong.empty()) {
+        line << ", ok";
+    } else {
+        line << ", " << wrong_count << " wrong values at";
+        for (size_t i = 0; i < wrong.size() && i < max_printed_ranges; i++) {
+            line << ' ' << wrong[i].first;
+            if (wrong[i].second != wrong[i].first)
+                line << '-' << wrong[i].second;
+        }
+        if (wrong.size() > max_printed_ranges)
+            line << " ...";
+    }
+
+    LOG("%s\n", line.str().c_str());
+
+    wrong_values += wrong_count;
+    std::vector<std::pair<int, int>>().swap(wrong);
+    total.add(r.tally);
+}
+
+} // namespace
+
+bool verify_database(const std::string &path, int threads)
+{
+    sec_val_path = path;
+
+    Rules::initRules();
+    MalomSolutionAccess::setVariantStripped();
+
+    bool ok = false;
+    try {
+        init_sector_graph();
+
+        if (!Sectors::hasDatabase())
+            throw std::runtime_error("No database files in " + path);
+
+        Verifier verifier(threads);
+        ok = verifier.run();
+    } catch (const std::exception &e) {
+        std::cerr << "Failed to verify " << ruleVariantName << ": " << e.what()
+                  << std::endl;
+    }
+
+    Sectors::release();
+    Rules::cleanup();
+
+    return ok;
+}
@@ -0,0 +1,41 @@
+// Malom, a Nine Men's Morris (and variants) player and solver program.
+// Copyright(C) 2007-2016  Gabor E. Gevay, Gabor Danner
+// Copyright (C) 2023-2024 The Sanmill developers (see AUTHORS file)
+//
+// See our webpage (and the paper linked from there):
+// http://compalg.inf.elte.hu/~ggevay/mills/index.php
+//
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PERFECT_VERIFIER_H_INCLUDED
+#define PERFECT_VERIFIER_H_INCLUDED
+
+#include <string>
+
+// Checks the database of the rule variant selected by perfect_init() in path.
+//
+// The sectors which the sector graph needs are looked for first: those which
+// are missing or cannot be read, and the sectors which depend on them, are
+// reported and not checked further. Then the value of every position of the
+// other sectors is compared with the best value of its moves, as the perfect
+// player computes them, by the given number of threads.
+//
+// A line is printed for each sector, with a checksum of its file, the number
+// of won, lost and drawn positions and the ranges of the positions whose
+// value is wrong, and at the end a histogram of the distances of the wins and
+// the losses. Returns true if the database is complete and consistent.
+bool verify_database(const std::string &path, int threads);
+
+#endif // PERFECT_VERIFIER_H_INCLUDED
@@ -23,49 +23,202 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "perfect_wrappers.h"
 
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+
 int ruleVariant;
 
 std::unordered_map<Id, int> sector_sizes;
 
-// This manages the lookup tables of the hash function: it keeps them in memory
-// for a few most recently accessed sectors.
-std::pair<int, Wrappers::gui_eval_elem2> Wrappers::WSector::hash(board a)
+namespace {
+
+// Probes hold this shared while they use a hash object. Loading and releasing
+// hash objects hold it exclusively, so a hash is never released under a probe.
+std::shared_mutex residency_mutex;
+
+// Sectors with a hash object, guarded by residency_mutex
+std::vector<::Sector *> resident;
+size_t loaded_bytes = 0;
+
+std::atomic<size_t> hash_memory_budget {size_t(1024) << 20};
+
+std::atomic<bool> prefetch_sectors {false};
+
+// Advanced whenever a hash is loaded. Probes stamp their sector with it, which
+// orders the sectors by last use without a shared counter on the probe path.
+std::atomic<int> epoch {0};
+
+// The caller holds residency_mutex exclusively
+void release_oldest_hash(const ::Sector *keep)
 {
-    static std::set<std::pair<int, ::Sector *>> loaded_hashes;
-    static std::map<::Sector *, int> loaded_hashes_inv;
-    static int timestamp = 0;
-
-    ::Sector *tmp = s;
-
-    if (s->hash == nullptr) {
-        // hash object is not present
-
-        if (loaded_hashes.size() == 8) {
-            // release one if there are too many
-            ::Sector *to_release = loaded_hashes.begin()->second;
-            LOG("Releasing hash: %s\n", to_release->id.to_string().c_str());
-            to_release->release_hash();
-            loaded_hashes.erase(loaded_hashes.begin());
-            loaded_hashes_inv.erase(to_release);
+    auto oldest = resident.end();
+    for (auto it = resident.begin(); it != resident.end(); ++it) {
+        if (*it != keep &&
+            (oldest == resident.end() ||
+             (*it)->last_access.load(std::memory_order_relaxed) <
+                 (*oldest)->last_access.load(std::memory_order_relaxed))) {
+            oldest = it;
         }
+    }
+
+    ::Sector *to_release = *oldest;
+    LOG("Releasing hash: %s\n", to_release->id.to_string().c_str());
+    loaded_bytes -= to_release->memory_usage();
+    to_release->release_hash();
+    resident.erase(oldest);
+}
+
+void load_hash(::Sector *s)
+{
+    std::unique_lock<std::shared_mutex> lock(residency_mutex);
+
+    // Another thread may have loaded it in the meantime
+    if (s->hash != nullptr) {
+        return;
+    }
+
+    LOG("Loading hash: %s\n", s->id.to_string().c_str());
+    s->allocate_hash();
+    if (prefetch_sectors) {
+        s->prefetch();
+    }
+    s->last_access.store(++epoch, std::memory_order_relaxed);
+    loaded_bytes += s->memory_usage();
+    resident.push_back(s);
+
+    // release the least recently used ones if there are too many, but always
+    // keep the one just loaded. The tables shared by the hashes of a W count
+    // once, and go with the last of those hashes.
+    while (loaded_bytes + HashTables::cached_bytes() > hash_memory_budget &&
+           resident.size() > 1) {
+        release_oldest_hash(s);
+        HashTables::release_unused();
+    }
+}
+
+// Calls f while the hash of s is resident, loading it if needed
+template <class F>
+void with_resident_hash(::Sector *s, F f)
+{
+    for (;;) {
+        {
+            std::shared_lock<std::shared_mutex> lock(residency_mutex);
+
+            if (s->hash != nullptr) {
+                // update access time, without writing the cache line when
+                // it is already up to date
+                const int now = epoch.load(std::memory_order_relaxed);
+                if (s->last_access.load(std::memory_order_relaxed) != now) {
+                    s->last_access.store(now, std::memory_order_relaxed);
+                }
+
+                f();
+                return;
+            }
+        }
+
+        // hash object is not present, load new one
+        load_hash(s);
+    }
+}
+
+// Calls f if the hash of s is resident and no other thread is loading or
+// releasing one at the moment. Returns whether f was called.
+template <class F>
+bool with_hash_if_resident(::Sector *s, F f)
+{
+    std::shared_lock<std::shared_mutex> lock(residency_mutex,
+                                             std::try_to_lock);
+
+    if (!lock.owns_lock() || s->hash == nullptr) {
+        return false;
+    }
+
+    const int now = epoch.load(std::memory_order_relaxed);
+    if (s->last_access.load(std::memory_order_relaxed) != now) {
+        s->last_access.store(now, std::memory_order_relaxed);
+    }
+
+    f();
+    return true;
+}
+
+} // namespace
+
+void Wrappers::WSector::setHashMemoryBudget(size_t bytes)
+{
+    hash_memory_budget = bytes;
+}
 
-        // load new one
-        LOG("Loading hash: %s\n", s->id.to_string().c_str());
-        s->allocate_hash();
-    } else {
-        // update access time
-        loaded_hashes.erase(std::make_pair(loaded_hashes_inv[tmp], tmp));
+void Wrappers::WSector::setPrefetch(bool enabled)
+{
+    prefetch_sectors = enabled;
+}
+
+void Wrappers::WSector::releaseHashes()
+{
+    std::unique_lock<std::shared_mutex> lock(residency_mutex);
+
+    while (!resident.empty()) {
+        release_oldest_hash(nullptr);
     }
-    loaded_hashes.insert(std::make_pair(timestamp, tmp));
-    // s doesn't work here, which is probably a compiler bug!
-    loaded_hashes_inv[tmp] = timestamp;
 
-    timestamp++;
+    loaded_bytes = 0;
+    epoch = 0;
+}
+
+// This manages the lookup tables of the hash function: it keeps them in memory
+// for the most recently accessed sectors, as long as they fit in the budget.
+// Any number of threads may probe at the same time.
+std::pair<int, Wrappers::gui_eval_elem2> Wrappers::WSector::hash(board a)
+{
+    std::pair<int, eval_elem2> e {0, eval_elem2 {0, 0}};
+
+    with_resident_hash(s, [&] { e = s->hash->hash(a); });
 
-    auto e = s->hash->hash(a);
     return std::make_pair(e.first, Wrappers::gui_eval_elem2(e.second, s));
 }
 
+void Wrappers::WSector::hash(const board *a, size_t n,
+                             Wrappers::gui_eval_elem2 *out)
+{
+    with_resident_hash(s, [&] {
+        for (size_t i = 0; i < n; i++) {
+            out[i] = Wrappers::gui_eval_elem2(s->hash->hash(a[i]).second, s);
+        }
+    });
+}
+
+bool Wrappers::WSector::hashIfResident(board a, Wrappers::gui_eval_elem2 &out)
+{
+    return with_hash_if_resident(s, [&] {
+        out = Wrappers::gui_eval_elem2(s->hash->hash(a).second, s);
+    });
+}
+
+int Wrappers::WSector::size()
+{
+    int n = -1;
+
+    with_resident_hash(s, [&] {
+        if (s->file.is_open()) {
+            n = s->hash->hash_count;
+        }
+    });
+
+    return n;
+}
+
+void Wrappers::WSector::invHash(int first, int n, board *out)
+{
+    with_resident_hash(s, [&] {
+        for (int i = 0; i < n; i++) {
+            out[i] = s->hash->inv_hash(first + i);
+        }
+    });
+}
+
 void Wrappers::WID::negate()
 {
     int t = W;
@@ -54,6 +54,7 @@ static int f_inv_count[] {1,     4,     30,    158,    757,    2830,  8774,
 struct WID
 {
     int W, B, WF, BF;
+    WID() = default; // for fixed-size buffers, filled in later
     WID(int w, int b, int wf, int bf)
         : W(w)
         , B(b)
@@ -115,7 +116,34 @@ public:
 
     std::pair<int, Wrappers::gui_eval_elem2> hash(board a);
 
+    // Probes n boards of this sector at once, writing the values to out
+    void hash(const board *a, size_t n, Wrappers::gui_eval_elem2 *out);
+
+    // Like hash(), but never waits for the disk: returns false instead of
+    // loading the hash object or waiting for another thread to load one
+    bool hashIfResident(board a, Wrappers::gui_eval_elem2 &out);
+
     sec_val sval() { return s->sval; }
+
+    // The number of positions of this sector, or -1 if its file cannot be
+    // read
+    int size();
+
+    // Writes the boards of the positions first, ..., first + n - 1 to out
+    void invHash(int first, int n, board *out);
+
+    // Limits the memory used by the resident hash objects, their exception
+    // tables and the hash tables they share. The least recently used ones are
+    // released when a newly loaded one exceeds the budget.
+    static void setHashMemoryBudget(size_t bytes);
+
+    // Whether the values of a sector are read in from the disk in the
+    // background as soon as its hash object is loaded, so that the probes
+    // find them in memory instead of faulting them in one by one
+    static void setPrefetch(bool enabled);
+
+    // Releases all resident hash objects
+    static void releaseHashes();
 };
 
 struct gui_eval_elem2
@@ -132,6 +160,8 @@ private:
     eval_elem2 to_eval_elem2() const { return eval_elem2 {key1, key2}; }
 
 public:
+    gui_eval_elem2() = default; // for fixed-size buffers, filled in later
+
     // The viewpoint of key1 is s. However, if s is null, then
     // virt_unique_sec_val.
     gui_eval_elem2(sec_val key_1, int key_2, Sector *sec)
@@ -247,7 +277,21 @@ public:
 #endif
     }
 
-    sec_val akey1() { return key1 + (s ? s->sval : virt_unique_sec_val()); }
+    // The distance of a win or a loss, in the steps of the database
+    int steps() const { return key2; }
+
+    sec_val akey1() const
+    {
+        return key1 + (s ? s->sval : virt_unique_sec_val());
+    }
+
+    // 1 for a win, -1 for a loss and 0 otherwise. This is the first letter of
+    // toString(), without building the string.
+    int outcome() const
+    {
+        const sec_val a = akey1();
+        return a == ::virt_win_val ? 1 : (a == ::virt_loss_val ? -1 : 0);
+    }
 
     std::string toString()
     {
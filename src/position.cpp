@@ -15,6 +15,7 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <algorithm>
+#include <cstring>
 #include <iomanip>
 #include <sstream>
 #include <string> // std::string, std::stoi
@@ -533,13 +534,103 @@ void Position::do_move(Move m)
     move = m;
 }
 
+/// Position::do_move() with a StateInfo saves what the move may change into
+/// newSt and links it to the current state, so that the search can retract
+/// the move later with undo_move().
+
+void Position::do_move(Move m, StateInfo &newSt)
+{
+    newSt.rule50 = st.rule50;
+    newSt.pliesFromNull = st.pliesFromNull;
+    newSt.key = st.key;
+    newSt.previous = st.previous;
+
+    std::copy(std::begin(byTypeBB), std::end(byTypeBB), newSt.byTypeBB);
+    std::copy(std::begin(byColorBB), std::end(byColorBB), newSt.byColorBB);
+    std::copy(std::begin(pieceInHandCount), std::end(pieceInHandCount),
+              newSt.pieceInHandCount);
+    std::copy(std::begin(pieceOnBoardCount), std::end(pieceOnBoardCount),
+              newSt.pieceOnBoardCount);
+    std::copy(std::begin(pieceToRemoveCount), std::end(pieceToRemoveCount),
+              newSt.pieceToRemoveCount);
+
+    newSt.mobilityDiff = mobilityDiff;
+    newSt.gamePly = gamePly;
+    newSt.currentSquare = currentSquare;
+    newSt.move = move;
+    newSt.fromPiece = board[from_sq(m)];
+    newSt.toPiece = board[to_sq(m)];
+    newSt.sideToMove = sideToMove;
+    newSt.them = them;
+    newSt.winner = winner;
+    newSt.isNeedStalemateRemoval = isNeedStalemateRemoval;
+    newSt.isStalemateRemoving = isStalemateRemoving;
+    newSt.phase = phase;
+    newSt.action = action;
+    newSt.gameOverReason = gameOverReason;
+
+    st.previous = &newSt;
+
+    do_move(m);
+}
+
 /// Position::undo_move() unmakes a move. When it returns, the position should
-/// be restored to exactly the same state as before the move was made.
+/// be restored to exactly the same state as before the move was made. Only the
+/// from and to squares and the marked pieces cleared at the end of the placing
+/// phase can have changed on the board.
 
-void Position::undo_move(Sanmill::Stack<Position> &ss)
+void Position::undo_move(Move m)
 {
-    memcpy(this, ss.top(), sizeof(Position));
-    ss.pop();
+    assert(st.previous != nullptr);
+
+    const StateInfo &prev = *st.previous;
+
+    if (const Bitboard marked = prev.byTypeBB[MARKED] & ~byTypeBB[MARKED]) {
+        for (Square s = SQ_BEGIN; s < SQ_END; ++s) {
+            if (marked & square_bb(s)) {
+                board[s] = MARKED_PIECE;
+            }
+        }
+    }
+
+    board[from_sq(m)] = prev.fromPiece;
+    board[to_sq(m)] = prev.toPiece;
+
+    // Take back the score of a game that ended with this move
+    if (phase == Phase::gameOver && prev.phase != Phase::gameOver) {
+        if (winner == DRAW) {
+            score_draw--;
+        } else {
+            score[winner]--;
+        }
+    }
+
+    std::copy(std::begin(prev.byTypeBB), std::end(prev.byTypeBB), byTypeBB);
+    std::copy(std::begin(prev.byColorBB), std::end(prev.byColorBB), byColorBB);
+    std::copy(std::begin(prev.pieceInHandCount),
+              std::end(prev.pieceInHandCount), pieceInHandCount);
+    std::copy(std::begin(prev.pieceOnBoardCount),
+              std::end(prev.pieceOnBoardCount), pieceOnBoardCount);
+    std::copy(std::begin(prev.pieceToRemoveCount),
+              std::end(prev.pieceToRemoveCount), pieceToRemoveCount);
+
+    mobilityDiff = prev.mobilityDiff;
+    gamePly = prev.gamePly;
+    currentSquare = prev.currentSquare;
+    move = prev.move;
+    sideToMove = prev.sideToMove;
+    them = prev.them;
+    winner = prev.winner;
+    isNeedStalemateRemoval = prev.isNeedStalemateRemoval;
+    isStalemateRemoving = prev.isStalemateRemoving;
+    phase = prev.phase;
+    action = prev.action;
+    gameOverReason = prev.gameOverReason;
+
+    st.rule50 = prev.rule50;
+    st.pliesFromNull = prev.pliesFromNull;
+    st.key = prev.key;
+    st.previous = prev.previous;
 }
 
 /// Position::key_after() computes the new hash key after the given move. Needed
@@ -576,7 +667,7 @@ Key Position::key_after(Move m) const
 // Position::has_repeated() tests whether there has been at least one repetition
 // of positions since the last remove.
 
-bool Position::has_repeated(Sanmill::Stack<Position> &ss) const
+bool Position::has_repeated() const
 {
     for (int i = static_cast<int>(posKeyHistory.size()) - 2; i >= 0; i--) {
         if (key() == posKeyHistory[i]) {
@@ -584,13 +675,11 @@ bool Position::has_repeated(Sanmill::Stack<Position> &ss) const
         }
     }
 
-    const int size = ss.size();
-
-    for (int i = size - 1; i >= 0; i--) {
-        if (type_of(ss[i].move) == MOVETYPE_REMOVE) {
+    for (const StateInfo *p = st.previous; p != nullptr; p = p->previous) {
+        if (type_of(p->move) == MOVETYPE_REMOVE) {
             break;
         }
-        if (key() == ss[i].st.key) {
+        if (key() == p->key) {
             return true;
         }
     }
@@ -1586,7 +1675,7 @@ void Position::updateMobility(MoveType mt, Square s)
     }
 }
 
-int Position::total_mills_count(Color c)
+int Position::total_mills_count(Color c) const
 {
     assert(c == WHITE || c == BLACK);
 
@@ -1645,7 +1734,7 @@ int Position::total_mills_count(Color c)
     return n;
 }
 
-bool Position::is_board_full_removal_at_placing_phase_end()
+bool Position::is_board_full_removal_at_placing_phase_end() const
 {
     if (rule.pieceCount == 12 &&
         rule.boardFullAction != BoardFullAction::firstPlayerLose &&
@@ -1671,7 +1760,7 @@ bool Position::is_adjacent_to(Square s, Color c)
     return false;
 }
 
-bool Position::is_stalemate_removal()
+bool Position::is_stalemate_removal() const
 {
     if (is_board_full_removal_at_placing_phase_end()) {
         return true;
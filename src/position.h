@@ -24,7 +24,6 @@
 #include <vector>
 
 #include "rule.h"
-#include "stack.h"
 #include "types.h"
 
 #ifdef NNUE_GENERATE_TRAINING_DATA
@@ -39,6 +38,8 @@ using std::string;
 /// StateInfo struct stores information needed to restore a Position object to
 /// its previous state when we retract a move. Whenever a move is made on the
 /// board (by calling Position::do_move), a StateInfo object must be passed.
+/// It keeps the counters, bitboards and the pieces on the from and to squares
+/// only, which is all undo_move() needs to rebuild the board.
 
 struct StateInfo
 {
@@ -48,6 +49,28 @@ struct StateInfo
 
     // Not copied when making a move (will be recomputed anyhow)
     Key key;
+
+    // Saved by do_move() and restored by undo_move()
+    StateInfo *previous {nullptr};
+    Bitboard byTypeBB[PIECE_TYPE_NB];
+    Bitboard byColorBB[COLOR_NB];
+    int pieceInHandCount[COLOR_NB];
+    int pieceOnBoardCount[COLOR_NB];
+    int pieceToRemoveCount[COLOR_NB];
+    int mobilityDiff;
+    int gamePly;
+    Square currentSquare;
+    Move move;
+    Piece fromPiece;
+    Piece toPiece;
+    Color sideToMove;
+    Color them;
+    Color winner;
+    bool isNeedStalemateRemoval;
+    bool isStalemateRemoving;
+    Phase phase;
+    Action action;
+    GameOverReason gameOverReason;
 };
 
 /// Position class stores information regarding the board representation as
@@ -89,7 +112,8 @@ public:
 
     // Doing and undoing moves
     void do_move(Move m);
-    void undo_move(Sanmill::Stack<Position> &ss);
+    void do_move(Move m, StateInfo &newSt);
+    void undo_move(Move m);
 
     // Accessing hash keys
     Key key() const noexcept;
@@ -104,7 +128,7 @@ public:
     int game_ply() const;
     Thread *this_thread() const;
     bool has_game_cycle() const;
-    bool has_repeated(Sanmill::Stack<Position> &ss) const;
+    bool has_repeated() const;
     unsigned int rule50_count() const;
 
     /// Mill Game
@@ -129,7 +153,7 @@ public:
     Color get_winner() const noexcept;
     void set_gameover(Color w, GameOverReason reason);
 
-    bool is_stalemate_removal();
+    bool is_stalemate_removal() const;
 
     void flipHorizontally(std::vector<std::string> &gameMoveList,
                           bool cmdChange = true);
@@ -185,8 +209,8 @@ public:
     bool move_piece(File f1, Rank r1, File f2, Rank r2);
     bool move_piece(Square from, Square to);
 
-    int total_mills_count(Color c);
-    bool is_board_full_removal_at_placing_phase_end();
+    int total_mills_count(Color c) const;
+    bool is_board_full_removal_at_placing_phase_end() const;
     bool is_adjacent_to(Square s, Color c);
 
     bool handle_placing_phase_end();
@@ -14,12 +14,18 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
 #include "endgame.h"
 #include "evaluate.h"
 #include "mcts.h"
 #include "option.h"
 #include "uci.h"
 #include "thread.h"
+#include "timeman.h"
 
 #if defined(GABOR_MALOM_PERFECT_AI)
 #include "perfect_adaptor.h"
@@ -28,16 +34,102 @@
 using Eval::evaluate;
 using std::string;
 
-Value MTDF(Position *pos, Sanmill::Stack<Position> &ss, Value firstguess,
-           Depth depth, Depth originDepth, Move &bestMove);
+Value MTDF(Position *pos, Value firstguess, Depth depth, Depth originDepth,
+           Move &bestMove);
+
+Value aspiration_search(Position *pos, Depth depth, Value prevValue,
+                        Move &bestMove);
 
-Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth,
-              Depth originDepth, Value alpha, Value beta, Move &bestMove);
+Value qsearch(Position *pos, Depth depth, Depth originDepth, Value alpha,
+              Value beta, Move &bestMove);
 
 Value random_search(Position *pos, Move &bestMove);
 
 bool is_timeout(TimePoint startTime);
 
+namespace Search {
+
+LimitsType Limits;
+
+} // namespace Search
+
+using Search::Limits;
+
+namespace {
+
+// The deepest iteration of a search without a depth limit. Beyond it the
+// depth bonus of decisive values would overflow VALUE_INFINITE.
+constexpr Depth MAX_SEARCH_DEPTH = 30;
+
+// Close to the leaves the static ratings and the killers find the cutoff move
+// first nearly every time, and a TT move only gets in their way
+constexpr Depth TT_MOVE_MIN_DEPTH = 6;
+
+// update_pv() makes move the head of the line at ply, followed by the line
+// just returned by the child node
+void update_pv(Thread *th, int ply, Move move)
+{
+    const int childLength = ply + 1 < MAX_PLY ? th->pvLength[ply + 1] :
+                                                ply + 1;
+
+    th->pvTable[ply][ply] = move;
+
+    for (int i = ply + 1; i < childLength; i++) {
+        th->pvTable[ply][i] = th->pvTable[ply + 1][i];
+    }
+
+    th->pvLength[ply] = std::max(childLength, ply + 1);
+}
+
+// save_pv() keeps the root line of a completed iteration. The root may have
+// been resolved without a move loop (single reply, perfect database), in which
+// case the line is the best move alone.
+void save_pv(Thread *th, Move best)
+{
+    if (best == MOVE_NONE) {
+        th->pv.clear();
+        return;
+    }
+
+    th->pv.assign(th->pvTable[0], th->pvTable[0] + th->pvLength[0]);
+
+    if (th->pv.empty() || th->pv.front() != best) {
+        th->pv.assign(1, best);
+    }
+}
+
+// stat_bonus() is the history bonus of a beta cutoff at the given depth
+int stat_bonus(Depth d)
+{
+    return std::min(32 * d * d, 4096);
+}
+
+// update_stats() updates the move ordering statistics of the thread when move
+// caused a beta cutoff at ply, after the moves in searched had failed to
+void update_stats(Thread *th, const Position *pos, int ply, Move move,
+                  Move prevMove, Depth depth, const Move *searched,
+                  int searchedCount)
+{
+    const Color us = pos->side_to_move();
+    const int bonus = stat_bonus(depth);
+
+    if (th->killers[ply][0] != move) {
+        th->killers[ply][1] = th->killers[ply][0];
+        th->killers[ply][0] = move;
+    }
+
+    th->counterMoves[history_from(prevMove)][to_sq(prevMove)] = move;
+
+    th->mainHistory[us][history_from(move)][to_sq(move)] << bonus;
+
+    for (int i = 0; i < searchedCount; i++) {
+        th->mainHistory[us][history_from(searched[i])][to_sq(searched[i])]
+            << -bonus;
+    }
+}
+
+} // namespace
+
 /// Search::init() is called at startup
 
 void Search::init() noexcept { }
@@ -61,11 +153,11 @@ extern Value nnueTrainingDataBestValue;
 /// Thread::search() is the main iterative deepening loop. It calls search()
 /// repeatedly with increasing depth until the allocated thinking time has been
 /// consumed, the user stops the search, or the maximum search depth is reached.
+/// When the pool has more than one thread, the main thread also starts the
+/// helper threads and picks the final result among them.
 
 int Thread::search()
 {
-    Sanmill::Stack<Position> ss;
-
 #if defined(GABOR_MALOM_PERFECT_AI)
     Move fallbackMove = MOVE_NONE;
     Value fallbackValue = VALUE_UNKNOWN;
@@ -91,9 +183,34 @@ int Thread::search()
         originDepth = d;
     }
 
+    // Only the main thread of the pool reports its progress and follows the
+    // limits of the "go" command. The AI threads of the Qt GUI are not part
+    // of the pool and search with the game options alone.
+    const bool mainThread = !Threads.empty() && this == Threads.front();
+    const bool limited = mainThread && Limits.limited();
+
+    if (limited) {
+        originDepth = Limits.depth ? static_cast<Depth>(std::min<int>(
+                                         Limits.depth, MAX_SEARCH_DEPTH)) :
+                                     MAX_SEARCH_DEPTH;
+    }
+
     const time_t time0 = time(nullptr);
     srand(static_cast<unsigned int>(time0));
 
+    startTime = mainThread && Limits.startTime ? Limits.startTime : now();
+    rootPly = rootPos->game_ply();
+
+    if (mainThread) {
+        Time.init(Limits, rootPos->side_to_move());
+    }
+
+    // Result of the last completed iteration, played if the search is
+    // stopped in the middle of the next one
+    Move completedMove = MOVE_NONE;
+    Value completedValue = VALUE_ZERO;
+    bool interrupted = false;
+
 #ifdef TIME_STAT
     auto timeStart = chrono::steady_clock::now();
     chrono::steady_clock::time_point timeEnd;
@@ -153,32 +270,69 @@ int Thread::search()
         beta = VALUE_INFINITE;
     }
 
-    if (gameOptions.getMoveTime() > 0 || gameOptions.getIDSEnabled()) {
+    // Lazy SMP: every thread of the pool searches the root position with its
+    // own copy of it, and they cooperate only through the shared TT. The
+    // AI threads of the Qt GUI are not part of the pool and search alone.
+    const bool lazySmp = Threads.size() > 1 && this == Threads.front() &&
+                         gameOptions.getAlgorithm() <= 2 /* AB, PVS, MTD(f) */;
+
+    completedDepth = 0;
+    bestMove = MOVE_NONE;
+    pvLength[0] = 0;
+    pv.clear();
+
+    for (auto &k : killers) {
+        k[0] = k[1] = MOVE_NONE;
+    }
+
+    if (lazySmp) {
+#ifdef TRANSPOSITION_TABLE_ENABLE
+        // The table is shared by all threads, so it is aged once per search
+        // instead of once per iteration.
+        TT.new_search();
+#endif
+        Threads.start_searching();
+    }
+
+    Value lastValue = VALUE_ZERO;
+
+    if (gameOptions.getMoveTime() > 0 || gameOptions.getIDSEnabled() ||
+        limited) {
         debugPrintf("IDS: ");
 
         constexpr Depth depthBegin = 2;
-        Value lastValue = VALUE_ZERO;
-
-        const TimePoint startTime = now();
 
         for (Depth i = depthBegin; i < originDepth; i += 1) {
+            selDepth = 0;
+
 #ifdef TRANSPOSITION_TABLE_ENABLE
 #ifdef CLEAR_TRANSPOSITION_TABLE
-            TranspositionTable::clear();
+            if (!lazySmp) {
+                TT.new_search();
+            }
 #endif
 #endif
 
             if (gameOptions.getAlgorithm() == 2 /* MTD(f) */) {
                 // debugPrintf("Algorithm: MTD(f).\n");
-                value = MTDF(rootPos, ss, value, i, i, bestMove);
+                value = MTDF(rootPos, value, i, i, bestMove);
             } else if (gameOptions.getAlgorithm() == 3 /* MCTS */) {
                 value = monte_carlo_tree_search(rootPos, bestMove);
             } else if (gameOptions.getAlgorithm() == 4 /* Random */) {
                 value = random_search(rootPos, bestMove);
+            } else if (i > depthBegin) {
+                value = aspiration_search(rootPos, i, lastValue, bestMove);
             } else {
-                value = qsearch(rootPos, ss, i, i, alpha, beta, bestMove);
+                value = qsearch(rootPos, i, i, alpha, beta, bestMove);
+            }
+
+            if (Threads.stop.load(std::memory_order_relaxed)) {
+                interrupted = true;
+                goto out;
             }
 
+            completedDepth = i;
+
 #if defined(GABOR_MALOM_PERFECT_AI)
             fallbackMove = bestMove;
             fallbackValue = value;
@@ -214,11 +368,20 @@ int Thread::search()
 next:
 #endif // GABOR_MALOM_PERFECT_AI
 
+            completedMove = bestMove;
+            completedValue = value;
+            save_pv(this, bestMove);
+
+            if (mainThread) {
+                sync_cout << UCI::pv(this, i) << sync_endl;
+            }
+
             debugPrintf("%d(%d) ", value, value - lastValue);
 
             lastValue = value;
 
-            if (is_timeout(startTime)) {
+            if (mainThread ? Time.optimum() && Time.elapsed() > Time.optimum() :
+                             is_timeout(startTime)) {
                 debugPrintf("originDepth = %d, depth = %d\n", originDepth, i);
                 goto out;
             }
@@ -234,7 +397,9 @@ next:
 
 #ifdef TRANSPOSITION_TABLE_ENABLE
 #ifdef CLEAR_TRANSPOSITION_TABLE
-    TranspositionTable::clear();
+    if (!lazySmp) {
+        TT.new_search();
+    }
 #endif
 #endif
 
@@ -244,16 +409,28 @@ next:
         beta = VALUE_INFINITE;
     }
 
+    selDepth = 0;
+
     if (gameOptions.getAlgorithm() == 2 /* MTD(f) */) {
-        value = MTDF(rootPos, ss, value, originDepth, originDepth, bestMove);
+        value = MTDF(rootPos, value, originDepth, originDepth, bestMove);
     } else if (gameOptions.getAlgorithm() == 3 /* MCTS */) {
         value = monte_carlo_tree_search(rootPos, bestMove);
     } else if (gameOptions.getAlgorithm() == 4 /* Random */) {
         value = random_search(rootPos, bestMove);
+    } else if (completedDepth > 0) {
+        value = aspiration_search(rootPos, originDepth, lastValue, bestMove);
     } else {
-        value = qsearch(rootPos, ss, d, originDepth, alpha, beta, bestMove);
+        value = qsearch(rootPos, originDepth, originDepth, alpha, beta,
+                        bestMove);
+    }
+
+    if (Threads.stop.load(std::memory_order_relaxed)) {
+        interrupted = true;
+        goto out;
     }
 
+    completedDepth = originDepth;
+
     fallbackMove = bestMove;
     fallbackValue = value;
     aiMoveType = AiMoveType::traditional;
@@ -283,6 +460,63 @@ next:
 
 out:
 
+    // In infinite mode the GUI expects no bestmove before "stop"
+    while (limited && Limits.infinite &&
+           !Threads.stop.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    if (interrupted) {
+        // A stopped iteration cannot be trusted, so play the result of the
+        // last completed one. Without any, keep the move found so far or at
+        // least a legal one.
+        if (completedMove != MOVE_NONE) {
+            bestMove = completedMove;
+            value = completedValue;
+        } else if (bestMove == MOVE_NONE) {
+            MovePicker mp(*rootPos);
+            bestMove = mp.next_move();
+        }
+    } else if (completedDepth == originDepth) {
+        save_pv(this, bestMove);
+    }
+
+    if (lazySmp) {
+        // Stop the helpers and wait for them to finish. Unless the perfect
+        // database has decided the move, prefer a helper which completed a
+        // deeper iteration with a score at least as good as ours.
+        Threads.stop = true;
+        Threads.wait_for_search_finished();
+
+        if (aiMoveType == AiMoveType::traditional && value != VALUE_UNIQUE) {
+            const Thread *bestThread = this;
+            Value bestThreadValue = value;
+
+            for (const Thread *th : Threads) {
+                if (th->completedDepth > bestThread->completedDepth &&
+                    th->bestMove != MOVE_NONE &&
+                    th->bestvalue >= bestThreadValue) {
+                    bestThread = th;
+                    bestThreadValue = th->bestvalue;
+                }
+            }
+
+            if (bestThread != this) {
+                debugPrintf("Lazy SMP: thread %zu bestMove = %s\n",
+                            bestThread->idx,
+                            UCI::move(bestThread->bestMove).c_str());
+                bestMove = bestThread->bestMove;
+                value = bestThreadValue;
+                pv = bestThread->pv;
+            }
+        }
+    }
+
+    // The iterations of the time limited search have been reported already
+    if (mainThread && completedDepth == originDepth) {
+        sync_cout << UCI::pv(this, originDepth) << sync_endl;
+    }
+
 #ifdef TIME_STAT
     timeEnd = chrono::steady_clock::now();
     debugPrintf(
@@ -296,6 +530,75 @@ out:
     return 0;
 }
 
+/// Thread::search_helper() is the iterative deepening loop of the helper
+/// threads of the Lazy SMP search. Each helper searches its own copy of the
+/// root position and skips some iterations depending on its index, so that
+/// the threads spread over different depths and fill the shared TT for the
+/// main thread. Odd helpers go one ply deeper than the main thread. The loop
+/// ends when the main thread sets Threads.stop. With MCTS the helpers grow
+/// the tree of the main thread instead.
+
+void Thread::search_helper()
+{
+    // Sizes and phases of the skip-blocks, used for distributing search depths
+    // across the helper threads
+    constexpr int SkipSize[] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+    constexpr int SkipPhase[] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3,
+                                 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+    constexpr size_t SkipNb = sizeof(SkipSize) / sizeof(SkipSize[0]);
+
+    Position &pos = rootCopy;
+
+    if (gameOptions.getAlgorithm() == 3 /* MCTS */) {
+        rootPly = pos.game_ply();
+        mcts_helper(&pos);
+        return;
+    }
+
+    const size_t i = (idx - 1) % SkipNb;
+    const Depth maxDepth = Threads.main()->originDepth +
+                           static_cast<Depth>(idx & 1);
+
+    Value value = VALUE_ZERO;
+    completedDepth = 0;
+    bestMove = MOVE_NONE;
+    bestvalue = VALUE_ZERO;
+    rootPly = pos.game_ply();
+    pvLength[0] = 0;
+    pv.clear();
+
+    for (auto &k : killers) {
+        k[0] = k[1] = MOVE_NONE;
+    }
+
+    for (Depth d = 1;
+         d <= maxDepth && !Threads.stop.load(std::memory_order_relaxed); ++d) {
+        if (d < maxDepth &&
+            ((d + pos.game_ply() + SkipPhase[i]) / SkipSize[i]) % 2) {
+            continue;
+        }
+
+        Move move = MOVE_NONE;
+
+        if (gameOptions.getAlgorithm() == 2 /* MTD(f) */) {
+            value = MTDF(&pos, value, d, d, move);
+        } else {
+            value = qsearch(&pos, d, d, -VALUE_INFINITE, VALUE_INFINITE, move);
+        }
+
+        // A stopped iteration cannot be trusted
+        if (Threads.stop.load(std::memory_order_relaxed)) {
+            break;
+        }
+
+        completedDepth = d;
+        bestMove = move;
+        bestvalue = value;
+        save_pv(this, move);
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 Value random_search(Position *pos, Move &bestMove)
@@ -318,14 +621,47 @@ Value random_search(Position *pos, Move &bestMove)
 
 vector<Key> posKeyHistory;
 
-Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth,
-              Depth originDepth, Value alpha, Value beta, Move &bestMove)
+Value qsearch(Position *pos, Depth depth, Depth originDepth, Value alpha,
+              Value beta, Move &bestMove)
 {
     Value value;
     Value bestValue = -VALUE_INFINITE;
 
     Depth epsilon;
 
+    // The AI threads of the Qt GUI search positions without a thread
+    Thread *const thisThread = pos->this_thread();
+
+    // Check for the available remaining time
+    if (thisThread != nullptr && !Threads.empty() &&
+        thisThread == Threads.front()) {
+        static_cast<MainThread *>(thisThread)->check_time();
+    }
+
+    const int ply = thisThread != nullptr ?
+                        pos->game_ply() - thisThread->rootPly :
+                        0;
+
+    // The PV and the move ordering statistics are kept by the alpha-beta
+    // searches only, as the MCTS workers share their thread. The root keeps
+    // its line until a move beats alpha, just like bestMove.
+    const bool threadTables = thisThread != nullptr && ply < MAX_PLY &&
+                         gameOptions.getAlgorithm() <= 2 /* AB, PVS, MTD(f) */;
+
+    if (threadTables && ply > 0) {
+        thisThread->pvLength[ply] = ply;
+    }
+
+    if (thisThread != nullptr) {
+        thisThread->nodes.fetch_add(1, std::memory_order_relaxed);
+
+        // Used to send selDepth info to GUI (selDepth counts from 1, ply
+        // from 0)
+        if (ply >= thisThread->selDepth.load(std::memory_order_relaxed)) {
+            thisThread->selDepth.store(ply + 1, std::memory_order_relaxed);
+        }
+    }
+
 #ifdef RULE_50
     if (pos->rule50_count() > rule.nMoveRule ||
         (rule.endgameNMoveRule < rule.nMoveRule && pos->is_three_endgame() &&
@@ -341,7 +677,7 @@ Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth,
     // Check if we have an upcoming move which draws by repetition, or
     // if the opponent had an alternative move earlier to this position.
     if (/* alpha < VALUE_DRAW && */
-        depth != originDepth && pos->has_repeated(ss)) {
+        depth != originDepth && pos->has_repeated()) {
         alpha = VALUE_DRAW;
         if (alpha >= beta) {
             return alpha;
@@ -349,8 +685,9 @@ Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth,
     }
 #endif // THREEFOLD_REPETITION
 
-#ifdef TT_MOVE_ENABLE
     Move ttMove = MOVE_NONE;
+#ifdef TT_MOVE_ENABLE
+    Move nodeBestMove = MOVE_NONE; // Best move of this node, for the TT
 #endif // TT_MOVE_ENABLE
 
     // Transposition table lookup
@@ -390,15 +727,24 @@ Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth,
 
     Bound type = BOUND_NONE;
 
-    const Value probeVal = TranspositionTable::probe(posKey, depth, alpha, beta,
-                                                     type
+    const Value probeVal = TT.probe(posKey, depth, alpha, beta, type
 #ifdef TT_MOVE_ENABLE
-                                                     ,
-                                                     ttMove
+                                    ,
+                                    ttMove
 #endif // TT_MOVE_ENABLE
     );
 
-    if (probeVal != VALUE_UNKNOWN) {
+    if (thisThread != nullptr) {
+        thisThread->ttProbes.fetch_add(1, std::memory_order_relaxed);
+        if (probeVal != VALUE_UNKNOWN) {
+            thisThread->ttHits.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // At the root a cutoff is only taken once we have a move to play, as the
+    // entry may have been stored by another thread of the Lazy SMP search
+    if (probeVal != VALUE_UNKNOWN &&
+        (depth != originDepth || bestMove != MOVE_NONE)) {
 #ifdef TRANSPOSITION_TABLE_DEBUG
         Threads.main()->ttHitCount++;
 #endif
@@ -422,6 +768,10 @@ Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth,
     if (unlikely(pos->phase == Phase::gameOver) || // TODO(calcitem): Deal with
                                                    // hash
         depth <= 0 || Threads.stop.load(std::memory_order_relaxed)) {
+        if (thisThread != nullptr) {
+            thisThread->qNodes.fetch_add(1, std::memory_order_relaxed);
+        }
+
         bestValue = Eval::evaluate(*pos);
 
         // For win quickly
@@ -439,13 +789,47 @@ Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth,
     // see if the position is a repeat. if so, we can assume that
     // this line is a draw and return VALUE_DRAW.
     if (rule.threefoldRepetitionRule && depth != originDepth &&
-        pos->has_repeated(ss)) {
+        pos->has_repeated()) {
         return VALUE_DRAW;
     }
 
+#if defined(GABOR_MALOM_PERFECT_AI)
+    // Probe the perfect database if it has the position in memory. Its value
+    // is exact, so the subtree is cut. The root is left to perfect_search().
+    if (depth != originDepth && gameOptions.getUsePerfectDatabase() &&
+        depth >= gameOptions.getPerfectDatabaseProbeDepth() &&
+        pos->piece_on_board_count(WHITE) + pos->piece_on_board_count(BLACK) +
+                pos->piece_in_hand_count(WHITE) +
+                pos->piece_in_hand_count(BLACK) <=
+            gameOptions.getPerfectDatabaseProbeLimit() &&
+        perfect_probe(pos, depth, bestValue)) {
+        if (thisThread != nullptr) {
+            thisThread->tbHits.fetch_add(1, std::memory_order_relaxed);
+        }
+
+#ifdef TRANSPOSITION_TABLE_ENABLE
+        TT.save(bestValue, depth, BOUND_EXACT, posKey
+#ifdef TT_MOVE_ENABLE
+                ,
+                MOVE_NONE
+#endif // TT_MOVE_ENABLE
+        );
+#endif // TRANSPOSITION_TABLE_ENABLE
+
+        return bestValue;
+    }
+#endif // GABOR_MALOM_PERFECT_AI
+
     // Initialize a MovePicker object for the current position, and prepare
     // to search the moves.
-    MovePicker mp(*pos);
+    const Move prevMove = pos->move;
+    MovePicker mp(*pos, depth >= TT_MOVE_MIN_DEPTH ? ttMove : MOVE_NONE,
+                  threadTables ? &thisThread->mainHistory : nullptr,
+                  threadTables ? thisThread->killers[ply] : nullptr,
+                  threadTables ? static_cast<Move>(
+                                     thisThread->counterMoves[history_from(
+                                         prevMove)][to_sq(prevMove)]) :
+                                 MOVE_NONE);
     const Move nextMove = mp.next_move();
     const int moveCount = mp.move_count();
 
@@ -457,23 +841,33 @@ Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth,
     }
 #endif /* !NNUE_GENERATE_TRAINING_DATA */
 
-#if 0
-    // TODO(calcitem): Weak
-    if (bestMove != MOVE_NONE) {
-        for (int i = 0; i < moveCount; i++) {
-            if (mp.moves[i].move == bestMove) {
-                // TODO(calcitem): need to write value?
-                std::swap(mp.moves[0], mp.moves[i]);
-                break;
+    // Search the move of the previous PV first while we are still on it
+    if (threadTables) {
+        if (ply == 0) {
+            thisThread->followPV = !thisThread->pv.empty();
+        }
+
+        if (thisThread->followPV) {
+            thisThread->followPV = false;
+
+            if (ply < static_cast<int>(thisThread->pv.size())) {
+                const auto pvMove = std::find_if(
+                    mp.moves, mp.moves + moveCount, [&](const ExtMove &m) {
+                        return m.move == thisThread->pv[ply];
+                    });
+
+                if (pvMove != mp.moves + moveCount) {
+                    std::rotate(mp.moves, pvMove, pvMove + 1);
+                    thisThread->followPV = true;
+                }
             }
         }
     }
-#endif // TT_MOVE_ENABLE
 
 #ifdef TRANSPOSITION_TABLE_ENABLE
 #ifndef DISABLE_PREFETCH
     for (int i = 0; i < moveCount; i++) {
-        TranspositionTable::prefetch(pos->key_after(mp.moves[i].move));
+        TT.prefetch(pos->key_after(mp.moves[i].move));
     }
 
 #ifdef PREFETCH_DEBUG
@@ -484,14 +878,21 @@ Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth,
 #endif // !DISABLE_PREFETCH
 #endif // TRANSPOSITION_TABLE_ENABLE
 
+    StateInfo st;
+    Move movesSearched[MAX_MOVES];
+    int searchedCount = 0;
+
     // Loop through the moves until no moves remain or a beta cutoff occurs
     for (int i = 0; i < moveCount; i++) {
-        ss.push(*pos);
+        if (i == 1) {
+            mp.score_remaining();
+        }
+
         const Color before = pos->sideToMove;
         const Move move = mp.moves[i].move;
 
         // Make and search the move
-        pos->do_move(move);
+        pos->do_move(move, st);
         const Color after = pos->sideToMove;
 
         if (gameOptions.getDepthExtension() == true && moveCount == 1) {
@@ -507,30 +908,30 @@ Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth,
 
             if (i == 0) {
                 if (after != before) {
-                    value = -qsearch(pos, ss, depth - 1 + epsilon, originDepth,
+                    value = -qsearch(pos, depth - 1 + epsilon, originDepth,
                                      -beta, -alpha, bestMove);
                 } else {
-                    value = qsearch(pos, ss, depth - 1 + epsilon, originDepth,
+                    value = qsearch(pos, depth - 1 + epsilon, originDepth,
                                     alpha, beta, bestMove);
                 }
             } else {
                 if (after != before) {
-                    value = -qsearch(pos, ss, depth - 1 + epsilon, originDepth,
+                    value = -qsearch(pos, depth - 1 + epsilon, originDepth,
                                      -alpha - VALUE_PVS_WINDOW, -alpha,
                                      bestMove);
 
                     if (value > alpha && value < beta) {
-                        value = -qsearch(pos, ss, depth - 1 + epsilon,
-                                         originDepth, -beta, -alpha, bestMove);
+                        value = -qsearch(pos, depth - 1 + epsilon, originDepth,
+                                         -beta, -alpha, bestMove);
                         // assert(value >= alpha && value <= beta);
                     }
                 } else {
-                    value = qsearch(pos, ss, depth - 1 + epsilon, originDepth,
+                    value = qsearch(pos, depth - 1 + epsilon, originDepth,
                                     alpha, alpha + VALUE_PVS_WINDOW, bestMove);
 
                     if (value > alpha && value < beta) {
-                        value = qsearch(pos, ss, depth - 1 + epsilon,
-                                        originDepth, alpha, beta, bestMove);
+                        value = qsearch(pos, depth - 1 + epsilon, originDepth,
+                                        alpha, beta, bestMove);
                         // assert(value >= alpha && value <= beta);
                     }
                 }
@@ -539,15 +940,20 @@ Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth,
             // debugPrintf("Algorithm: Alpha-Beta.\n");
 
             if (after != before) {
-                value = -qsearch(pos, ss, depth - 1 + epsilon, originDepth,
-                                 -beta, -alpha, bestMove);
+                value = -qsearch(pos, depth - 1 + epsilon, originDepth, -beta,
+                                 -alpha, bestMove);
             } else {
-                value = qsearch(pos, ss, depth - 1 + epsilon, originDepth,
-                                alpha, beta, bestMove);
+                value = qsearch(pos, depth - 1 + epsilon, originDepth, alpha,
+                                beta, bestMove);
             }
         }
 
-        pos->undo_move(ss);
+        pos->undo_move(move);
+
+        // Only the first move of a node can lie on the previous PV
+        if (threadTables) {
+            thisThread->followPV = false;
+        }
 
         // assert(value > -VALUE_INFINITE && value < VALUE_INFINITE);
 
@@ -566,24 +972,41 @@ Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth,
                     bestMove = move;
                 }
 
+#ifdef TT_MOVE_ENABLE
+                nodeBestMove = move;
+#endif // TT_MOVE_ENABLE
+
+                if (threadTables) {
+                    update_pv(thisThread, ply, move);
+                }
+
                 if (value < beta) {
                     // Update alpha! Always alpha < beta
                     alpha = value;
                 } else {
                     assert(value >= beta); // Fail high
-                    break;                 // Fail high
+                    if (thisThread != nullptr) {
+                        thisThread->betaCutoffs.fetch_add(
+                            1, std::memory_order_relaxed);
+                    }
+                    if (threadTables) {
+                        update_stats(thisThread, pos, ply, move, prevMove,
+                                     depth, movesSearched, searchedCount);
+                    }
+                    break; // Fail high
                 }
             }
         }
+
+        movesSearched[searchedCount++] = move;
     }
 
 #ifdef TRANSPOSITION_TABLE_ENABLE
-    TranspositionTable::save(
-        bestValue, depth,
-        TranspositionTable::boundType(bestValue, oldAlpha, beta), posKey
+    TT.save(bestValue, depth,
+            TranspositionTable::boundType(bestValue, oldAlpha, beta), posKey
 #ifdef TT_MOVE_ENABLE
-        ,
-        bestMove
+            ,
+            nodeBestMove
 #endif // TT_MOVE_ENABLE
     );
 #endif /* TRANSPOSITION_TABLE_ENABLE */
@@ -593,8 +1016,8 @@ Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth,
     return bestValue;
 }
 
-Value MTDF(Position *pos, Sanmill::Stack<Position> &ss, Value firstguess,
-           Depth depth, Depth originDepth, Move &bestMove)
+Value MTDF(Position *pos, Value firstguess, Depth depth, Depth originDepth,
+           Move &bestMove)
 {
     Value g = firstguess;
     Value lowerbound = -VALUE_INFINITE;
@@ -608,7 +1031,7 @@ Value MTDF(Position *pos, Sanmill::Stack<Position> &ss, Value firstguess,
             beta = g;
         }
 
-        g = qsearch(pos, ss, depth, originDepth, beta - VALUE_MTDF_WINDOW, beta,
+        g = qsearch(pos, depth, originDepth, beta - VALUE_MTDF_WINDOW, beta,
                     bestMove);
 
         if (g < beta) {
@@ -621,6 +1044,69 @@ Value MTDF(Position *pos, Sanmill::Stack<Position> &ss, Value firstguess,
     return g;
 }
 
+/// aspiration_search() searches the root in a narrow window around the score
+/// of the previous iteration. The window is widened on the failing side until
+/// the score falls inside it.
+
+Value aspiration_search(Position *pos, Depth depth, Value prevValue,
+                        Move &bestMove)
+{
+    // Widen in int, a Value is too narrow to hold the unclamped bounds
+    int delta = VALUE_ASPIRATION_WINDOW;
+    int alpha = std::max(static_cast<int>(prevValue) - delta,
+                         static_cast<int>(-VALUE_INFINITE));
+    int beta = std::min(static_cast<int>(prevValue) + delta,
+                        static_cast<int>(VALUE_INFINITE));
+
+    while (true) {
+        const Value value = qsearch(pos, depth, depth, static_cast<Value>(alpha),
+                                    static_cast<Value>(beta), bestMove);
+
+        if (Threads.stop.load(std::memory_order_relaxed)) {
+            return value;
+        }
+
+        if (value <= alpha && alpha > -VALUE_INFINITE) {
+            beta = (alpha + beta) / 2;
+            alpha = std::max(static_cast<int>(value) - delta,
+                             static_cast<int>(-VALUE_INFINITE));
+        } else if (value >= beta && beta < VALUE_INFINITE) {
+            beta = std::min(static_cast<int>(value) + delta,
+                            static_cast<int>(VALUE_INFINITE));
+        } else {
+            return value;
+        }
+
+        delta += delta / 2;
+    }
+}
+
+/// MainThread::check_time() is used to stop the search when the time budget
+/// of a "go" command with time controls is exhausted or when the node limit
+/// is reached.
+
+void MainThread::check_time()
+{
+    if (callsCnt.fetch_sub(1, std::memory_order_relaxed) > 1)
+        return;
+
+    // When using nodes, ensure checking rate is not lower than 0.1% of nodes
+    callsCnt.store(Limits.nodes ?
+                       static_cast<int>(std::min<int64_t>(
+                           1024, std::max<int64_t>(Limits.nodes / 1024, 1))) :
+                       1024,
+                   std::memory_order_relaxed);
+
+    // We should not stop pondering until told so by the GUI
+    if (ponder)
+        return;
+
+    if ((Time.maximum() && Time.elapsed() >= Time.maximum()) ||
+        (Limits.nodes && Threads.nodes_searched() >= (uint64_t)Limits.nodes)) {
+        Threads.stop = true;
+    }
+}
+
 bool is_timeout(TimePoint startTime)
 {
     const auto limit = gameOptions.getMoveTime() * 1000;
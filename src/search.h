@@ -20,6 +20,7 @@
 #include <vector>
 
 #include "endgame.h"
+#include "misc.h"
 
 #ifdef CYCLE_STAT
 #include "stopwatch.h"
@@ -29,6 +30,31 @@ using std::vector;
 
 namespace Search {
 
+/// LimitsType struct stores information sent by GUI about available time to
+/// search the current move, maximum depth/time, or if we are in analysis mode.
+
+struct LimitsType
+{
+    bool use_time_management() const noexcept
+    {
+        return time[WHITE] || time[BLACK];
+    }
+
+    // Whether the GUI gave any limit at all. A plain "go" searches to the
+    // depth of the skill level instead.
+    bool limited() const noexcept
+    {
+        return use_time_management() || movetime || depth || nodes ||
+               infinite;
+    }
+
+    TimePoint time[COLOR_NB] {}, inc[COLOR_NB] {}, movetime {0}, startTime {0};
+    int movestogo {0}, depth {0}, infinite {0};
+    int64_t nodes {0};
+};
+
+extern LimitsType Limits;
+
 void init() noexcept;
 void clear();
 
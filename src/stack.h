@@ -17,6 +17,8 @@
 #ifndef STACK_H_INCLUDED
 #define STACK_H_INCLUDED
 
+#include <cstring>
+
 namespace Sanmill {
 
 template <typename T, size_t capacity = 128>
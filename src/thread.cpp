@@ -14,7 +14,9 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
 #include <iomanip>
+#include <iostream>
 #include <sstream>
 #include <string>
 #include <utility>
@@ -78,8 +80,9 @@ Thread::~Thread()
 
 void Thread::clear() noexcept
 {
-    // TODO(calcitem): Reset histories
-    return;
+    mainHistory.fill(0);
+    counterMoves.fill(MOVE_NONE);
+    std::fill(&killers[0][0], &killers[0][0] + MAX_PLY * 2, MOVE_NONE);
 }
 
 /// Thread::start_searching() wakes up the thread that will start the search
@@ -133,6 +136,15 @@ void Thread::idle_loop()
 
         lk.unlock();
 
+        // Helper threads of the Lazy SMP search are woken up by the main
+        // thread through ThreadPool::start_searching() and never emit a move.
+        if (idx != 0) {
+            if (rootPos != nullptr) {
+                search_helper();
+            }
+            continue;
+        }
+
         // Note: Stockfish doesn't have this
         if (rootPos == nullptr || rootPos->side_to_move() != us) {
             continue;
@@ -181,7 +193,7 @@ void Thread::setAi(Position *p)
 
 #ifdef TRANSPOSITION_TABLE_ENABLE
 #ifdef CLEAR_TRANSPOSITION_TABLE
-    TranspositionTable::clear();
+    TT.new_search();
 #endif
 #endif
 }
@@ -417,6 +429,14 @@ void Thread::analyze(Color c) const
              << " pieces" << std::endl;
     }
 
+    if (!pv.empty()) {
+        cout << "Principal variation:";
+        for (const Move m : pv) {
+            cout << " " << UCI::move(m);
+        }
+        cout << std::endl;
+    }
+
     if (p->side_to_move() == WHITE) {
         cout << "White to move" << std::endl;
     } else {
@@ -579,21 +599,49 @@ void ThreadPool::set(size_t requested)
 
 void ThreadPool::clear() const
 {
-    for (const Thread *th : *this)
+    for (Thread *th : *this)
         th->clear();
 }
 
+/// ThreadPool::start_searching() wakes up all the helper threads. It is called
+/// by the main thread once the root position has been checked and the shared
+/// move ordering tables are ready. Each helper gets its own copy of the root
+/// position before the main thread starts making moves on it.
+
+void ThreadPool::start_searching() const
+{
+    for (Thread *th : *this)
+        if (th != front()) {
+            th->rootCopy = *front()->rootPos;
+            th->rootCopy.thisThread = th;
+            th->start_searching();
+        }
+}
+
+/// ThreadPool::wait_for_search_finished() waits for all helper threads to
+/// finish their search. Threads.stop should be already set.
+
+void ThreadPool::wait_for_search_finished() const
+{
+    for (Thread *th : *this)
+        if (th != front())
+            th->wait_for_search_finished();
+}
+
 /// ThreadPool::start_thinking() wakes up main thread waiting in idle_loop() and
 /// returns immediately. Main thread will wake up other threads and start the
 /// search.
 
-void ThreadPool::start_thinking(Position *pos, bool ponderMode)
+void ThreadPool::start_thinking(Position *pos,
+                                const Search::LimitsType &limits,
+                                bool ponderMode)
 {
     main()->wait_for_search_finished();
 
     main()->stopOnPonderhit = stop = false;
     increaseDepth = true;
     main()->ponder = ponderMode;
+    Search::Limits = limits;
 
     // We use Position::set() to set root position across threads.
     for (Thread *th : *this) {
@@ -604,6 +652,9 @@ void ThreadPool::start_thinking(Position *pos, bool ponderMode)
         // necessary).
         std::lock_guard lk(th->mutex);
         th->rootPos = pos;
+        th->nodes = th->qNodes = th->ttProbes = th->ttHits = 0;
+        th->betaCutoffs = th->tbHits = 0;
+        th->selDepth = 0;
     }
 
     main()->start_searching();
@@ -63,12 +63,14 @@ public:
     virtual ~Thread();
 #endif
     int search();
-    static void clear() noexcept;
+    void search_helper();
+    void clear() noexcept;
     void idle_loop();
     void start_searching();
     void wait_for_search_finished();
 
     Position *rootPos {nullptr};
+    Position rootCopy; // Lazy SMP helpers search on their own copy
 
     // Mill Game
 
@@ -116,10 +118,35 @@ public:
 #endif // TRANSPOSITION_TABLE_DEBUG
 #endif // TRANSPOSITION_TABLE_ENABLE
 
+    // Search statistics, reset by ThreadPool::start_thinking(). Leaf nodes
+    // are counted as qNodes, fail-highs of the move loop as betaCutoffs and
+    // the nodes resolved by the perfect database as tbHits.
+    std::atomic<uint64_t> nodes {0}, qNodes {0}, ttProbes {0}, ttHits {0},
+        betaCutoffs {0}, tbHits {0};
+    std::atomic<int> selDepth {0};
+    int rootPly {0};
+    TimePoint startTime {0};
+
     Depth originDepth {0};
+    Depth completedDepth {0};
 
     Move bestMove {MOVE_NONE};
     Value bestvalue {VALUE_ZERO};
+
+    // Triangular PV table filled by qsearch(), indexed by the distance from
+    // the root. pv is the line of the last completed iteration. Its moves are
+    // searched first by the next iteration as long as followPV is set.
+    Move pvTable[MAX_PLY][MAX_PLY] {};
+    int pvLength[MAX_PLY] {};
+    std::vector<Move> pv;
+    bool followPV {false};
+
+    // Move ordering statistics of the alpha-beta search, updated on beta
+    // cutoffs. The histories last until clear(), the killers one search.
+    ButterflyHistory mainHistory {};
+    CounterMoveHistory counterMoves {};
+    Move killers[MAX_PLY][2] {};
+
     Value lastvalue {VALUE_ZERO};
     AiMoveType aiMoveType {AiMoveType::unknown};
 
@@ -149,6 +176,9 @@ struct MainThread final : Thread
 {
     using Thread::Thread;
 
+    void check_time();
+
+    std::atomic<int> callsCnt {0};
     bool stopOnPonderhit {false};
     std::atomic_bool ponder {false};
 };
@@ -159,11 +189,23 @@ struct MainThread final : Thread
 
 struct ThreadPool : std::vector<Thread *>
 {
-    void start_thinking(Position *, bool = false);
+    void start_thinking(Position *, const Search::LimitsType &, bool = false);
     void clear() const;
     void set(size_t);
 
+    void start_searching() const;
+    void wait_for_search_finished() const;
+
     MainThread *main() const { return dynamic_cast<MainThread *>(front()); }
+    uint64_t nodes_searched() const { return accumulate(&Thread::nodes); }
+    uint64_t qnodes_searched() const { return accumulate(&Thread::qNodes); }
+    uint64_t tt_probes() const { return accumulate(&Thread::ttProbes); }
+    uint64_t tt_hits() const { return accumulate(&Thread::ttHits); }
+    uint64_t tb_hits() const { return accumulate(&Thread::tbHits); }
+    uint64_t beta_cutoffs() const
+    {
+        return accumulate(&Thread::betaCutoffs);
+    }
 
     std::atomic_bool stop, increaseDepth;
 
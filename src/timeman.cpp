@@ -0,0 +1,76 @@
+// This file is part of Sanmill.
+// Copyright (C) 2019-2024 The Sanmill developers (see AUTHORS file)
+//
+// Sanmill is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Sanmill is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+
+#include "option.h"
+#include "timeman.h"
+#include "uci.h"
+
+TimeManagement Time; // Our global time management object
+
+/// TimeManagement::init() is called at the beginning of the search and
+/// calculates the bounds of time allowed for the current game ply:
+///
+/// optimum: the search does not start a new iteration after this
+/// maximum: the search is stopped in the middle of an iteration after this
+///
+/// A plain "go" without limits keeps the MoveTime option as its budget.
+
+void TimeManagement::init(const Search::LimitsType &limits, Color us)
+{
+    const auto moveOverhead = static_cast<TimePoint>(Options["Move Overhead"]);
+    const auto slowMover = static_cast<TimePoint>(Options["Slow Mover"]);
+
+    startTime = limits.startTime;
+
+    if (limits.movetime) {
+        optimumTime = maximumTime = std::max<TimePoint>(
+            limits.movetime - moveOverhead, 1);
+        return;
+    }
+
+    if (!limits.use_time_management()) {
+        optimumTime = maximumTime = limits.limited() ?
+                                        0 :
+                                        gameOptions.getMoveTime() * 1000;
+        return;
+    }
+
+    // A game of mill rarely lasts more than 50 moves per side, so the time
+    // left is planned for at most that many moves
+    constexpr int MoveHorizon = 50;
+    const int mtg = limits.movestogo ?
+                        std::min(limits.movestogo, MoveHorizon) :
+                        MoveHorizon;
+
+    // Make sure timeLeft is > 0 since we may use it as a divisor
+    TimePoint timeLeft = std::max<TimePoint>(
+        1, limits.time[us] + limits.inc[us] * (mtg - 1) -
+               moveOverhead * (2 + mtg));
+
+    // The Slow Mover option scales the share of the remaining time
+    timeLeft = slowMover * timeLeft / 100;
+
+    optimumTime = std::max<TimePoint>(timeLeft / mtg, 1);
+
+    // Never use more than 80% of the clock in a single move
+    maximumTime = std::max<TimePoint>(
+        std::min<TimePoint>(5 * optimumTime,
+                            limits.time[us] * 8 / 10 - moveOverhead),
+        1);
+    optimumTime = std::min(optimumTime, maximumTime);
+}
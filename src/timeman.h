@@ -0,0 +1,43 @@
+// This file is part of Sanmill.
+// Copyright (C) 2019-2024 The Sanmill developers (see AUTHORS file)
+//
+// Sanmill is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Sanmill is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TIMEMAN_H_INCLUDED
+#define TIMEMAN_H_INCLUDED
+
+#include "misc.h"
+#include "search.h"
+
+/// The TimeManagement class computes the optimal time to think depending on
+/// the maximum available time, the game move number and other parameters.
+/// A budget of zero means that the search is not limited by time.
+
+class TimeManagement
+{
+public:
+    void init(const Search::LimitsType &limits, Color us);
+    TimePoint optimum() const noexcept { return optimumTime; }
+    TimePoint maximum() const noexcept { return maximumTime; }
+    TimePoint elapsed() const noexcept { return now() - startTime; }
+
+private:
+    TimePoint startTime {0};
+    TimePoint optimumTime {0};
+    TimePoint maximumTime {0};
+};
+
+extern TimeManagement Time;
+
+#endif // #ifndef TIMEMAN_H_INCLUDED
@@ -14,37 +14,265 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
-#include "tt.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
 #include <limits>
 
+#include "misc.h"
+#include "tt.h"
+
 #ifdef TRANSPOSITION_TABLE_ENABLE
 
-static constexpr int TRANSPOSITION_TABLE_SIZE = 0x1000000;
-HashMap<Key, TTEntry> TT(TRANSPOSITION_TABLE_SIZE);
+TranspositionTable TT; // Our global transposition table
+
+TranspositionTable::TranspositionTable()
+    : TranspositionTable(TRANSPOSITION_TABLE_DEFAULT_MB)
+{ }
+
+TranspositionTable::TranspositionTable(size_t mbSize)
+{
+    resize(mbSize);
+}
+
+TranspositionTable::~TranspositionTable()
+{
+#ifdef ALIGNED_LARGE_PAGES
+    aligned_large_pages_free(table);
+#else
+    std_aligned_free(table);
+#endif // ALIGNED_LARGE_PAGES
+}
+
+/// TranspositionTable::pack() and unpack() convert between TTEntry and the
+/// data word kept in a slot. A zero word decodes to BOUND_NONE, which marks
+/// an empty slot. save() keeps the depth within MaxDepth and new_search()
+/// the age within MaxAge.
+
+TranspositionTable::Word TranspositionTable::pack(const TTEntry &tte)
+{
+    Word data = static_cast<uint8_t>(tte.value8) |
+                static_cast<Word>(tte.depth8) << DepthShift |
+                static_cast<Word>(tte.genBound8) << BoundShift;
+
+#ifdef TRANSPOSITION_TABLE_FAKE_CLEAN
+    data |= static_cast<Word>(tte.age8) << AgeShift;
+#endif // TRANSPOSITION_TABLE_FAKE_CLEAN
+
+#ifdef TT_MOVE_ENABLE
+    data |= pack_move(tte.ttMove) << MoveShift;
+#endif // TT_MOVE_ENABLE
+
+    return data;
+}
+
+TTEntry TranspositionTable::unpack(Word data)
+{
+    TTEntry tte {};
+
+    tte.value8 = static_cast<int8_t>(data);
+    tte.depth8 = static_cast<int8_t>(data >> DepthShift & MaxDepth);
+    tte.genBound8 = static_cast<uint8_t>(bound_of(data));
 
 #ifdef TRANSPOSITION_TABLE_FAKE_CLEAN
-uint8_t transpositionTableAge;
+    tte.age8 = static_cast<uint8_t>(data >> AgeShift & MaxAge);
 #endif // TRANSPOSITION_TABLE_FAKE_CLEAN
 
+#ifdef TT_MOVE_ENABLE
+    tte.ttMove = unpack_move(data >> MoveShift);
+#endif // TT_MOVE_ENABLE
+
+    return tte;
+}
+
+Bound TranspositionTable::bound_of(Word data)
+{
+    return static_cast<Bound>(data >> BoundShift & BOUND_EXACT);
+}
+
+#ifdef TT_MOVE_ENABLE
+
+/// TranspositionTable::pack_move() and unpack_move() store a move in 10 bits.
+/// The low 5 bits hold the destination square and the high 5 bits the kind
+/// of move: 1 to 24 give the origin of a slide, PlaceCode marks a place and
+/// RemoveCode a removal. Zero is MOVE_NONE.
+
+namespace {
+
+constexpr int PlaceCode = SQUARE_NB + 1;
+constexpr int RemoveCode = SQUARE_NB + 2;
+
+} // namespace
+
+TranspositionTable::Word TranspositionTable::pack_move(Move m)
+{
+    if (m == MOVE_NONE || m == MOVE_NULL) {
+        return 0;
+    }
+
+    const Word to = to_sq(m) - SQ_BEGIN;
+
+    switch (type_of(m)) {
+    case MOVETYPE_PLACE:
+        return PlaceCode << 5 | to;
+    case MOVETYPE_REMOVE:
+        return RemoveCode << 5 | to;
+    case MOVETYPE_MOVE:
+        break;
+    }
+
+    return static_cast<Word>(from_sq(m) - SQ_BEGIN + 1) << 5 | to;
+}
+
+Move TranspositionTable::unpack_move(Word bits)
+{
+    const auto code = static_cast<int>(bits >> 5 & 31);
+    const auto to = static_cast<Square>((bits & 31) + SQ_BEGIN);
+
+    if (code == 0) {
+        return MOVE_NONE;
+    }
+
+    if (code == PlaceCode) {
+        return static_cast<Move>(to);
+    }
+
+    if (code == RemoveCode) {
+        return static_cast<Move>(-to);
+    }
+
+    return make_move(static_cast<Square>(code - 1 + SQ_BEGIN), to);
+}
+
+#endif // TT_MOVE_ENABLE
+
+/// TranspositionTable::first_entry() returns a pointer to the cluster of the
+/// given key. The key is scrambled first because Zobrist keys keep the misc
+/// bits at the top, which would otherwise decide the cluster index alone.
+
+TranspositionTable::Cluster *TranspositionTable::first_entry(Key key) const
+{
+    return &table[mul_hi64(static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ULL,
+                           clusterCount)];
+}
+
+/// TranspositionTable::resize() sets the size of the transposition table,
+/// measured in megabytes. The number of clusters need not be a power of 2,
+/// as first_entry() maps keys onto the table with a multiply-high.
+
+void TranspositionTable::resize(size_t mbSize)
+{
+    const size_t newClusterCount = mbSize * 1024 * 1024 / sizeof(Cluster);
+
+    if (newClusterCount == clusterCount)
+        return;
+
+#ifdef ALIGNED_LARGE_PAGES
+    aligned_large_pages_free(table);
+    table = static_cast<Cluster *>(
+        aligned_large_pages_alloc(newClusterCount * sizeof(Cluster)));
+#else
+    std_aligned_free(table);
+    table = static_cast<Cluster *>(
+        std_aligned_alloc(alignof(Cluster), newClusterCount * sizeof(Cluster)));
+#endif // ALIGNED_LARGE_PAGES
+
+    if (!table) {
+        std::cerr << "Failed to allocate " << mbSize
+                  << "MB for transposition table." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    clusterCount = newClusterCount;
+    clear();
+}
+
+/// TranspositionTable::clear() wipes the whole table and restarts the age
+/// counter. It is called when the GUI asks for a new game or a new size.
+
+void TranspositionTable::clear()
+{
+    std::memset(static_cast<void *>(table), 0, clusterCount * sizeof(Cluster));
+
+#ifdef TRANSPOSITION_TABLE_FAKE_CLEAN
+    age8 = 0;
+#endif // TRANSPOSITION_TABLE_FAKE_CLEAN
+}
+
+/// TranspositionTable::new_search() invalidates all entries before a new
+/// search. With TRANSPOSITION_TABLE_FAKE_CLEAN this is just an age bump, and
+/// the table is only wiped when the age counter wraps around.
+
+void TranspositionTable::new_search()
+{
+#ifdef TRANSPOSITION_TABLE_FAKE_CLEAN
+    if (age8 == MaxAge) {
+        debugPrintf("Clean TT\n");
+        clear();
+    } else {
+        age8++;
+    }
+#else
+    clear();
+#endif // TRANSPOSITION_TABLE_FAKE_CLEAN
+}
+
+/// TranspositionTable::hashfull() returns an approximation of the table
+/// occupation during a search, in permill as per the UCI protocol. It samples
+/// the first thousand slots and only counts entries of the current search.
+
+int TranspositionTable::hashfull() const
+{
+    const size_t clusters = std::min<size_t>(1000 / ClusterSize,
+                                             clusterCount);
+    int cnt = 0;
+
+    for (size_t i = 0; i < clusters; ++i) {
+        for (int j = 0; j < ClusterSize; ++j) {
+            const TTEntry tte = unpack(
+                table[i].slot[j].data.load(std::memory_order_relaxed));
+
+#ifdef TRANSPOSITION_TABLE_FAKE_CLEAN
+            cnt += tte.bound() != BOUND_NONE && tte.age8 == age8;
+#else
+            cnt += tte.bound() != BOUND_NONE;
+#endif // TRANSPOSITION_TABLE_FAKE_CLEAN
+        }
+    }
+
+    return clusters ? cnt * 1000 / static_cast<int>(clusters * ClusterSize) :
+                      0;
+}
+
 Value TranspositionTable::probe(Key key, Depth depth, Value alpha, Value beta,
                                 Bound &type
 #ifdef TT_MOVE_ENABLE
                                 ,
                                 Move &ttMove
 #endif // TT_MOVE_ENABLE
-)
+) const
 {
     TTEntry tte {};
 
-    if (!TT.find(key, tte)) {
+    if (!search(key, tte)) {
         return VALUE_UNKNOWN;
     }
 
+#ifdef TT_MOVE_ENABLE
+    // The move is only used for ordering, so it is worth returning even from
+    // a stale entry. The move of a much shallower search is a worse guess than
+    // the killers and the history, though.
+    if (tte.depth() + 1 >= depth) {
+        ttMove = tte.ttMove;
+    }
+#endif // TT_MOVE_ENABLE
+
 #ifdef TRANSPOSITION_TABLE_FAKE_CLEAN
 #ifdef TRANSPOSITION_TABLE_FAKE_CLEAN_NOT_EXACT_ONLY
-    if (tte.type != BOUND_EXACT) {
+    if (tte.bound() != BOUND_EXACT) {
 #endif
-        if (tte.age8 != transpositionTableAge) {
+        if (tte.age8 != age8) {
             return VALUE_UNKNOWN;
         }
 #ifdef TRANSPOSITION_TABLE_FAKE_CLEAN_NOT_EXACT_ONLY
@@ -53,7 +281,7 @@ Value TranspositionTable::probe(Key key, Depth depth, Value alpha, Value beta,
 #endif // TRANSPOSITION_TABLE_FAKE_CLEAN
 
     if (depth > tte.depth()) {
-        goto out;
+        return VALUE_UNKNOWN;
     }
 
     type = tte.bound();
@@ -75,59 +303,115 @@ Value TranspositionTable::probe(Key key, Depth depth, Value alpha, Value beta,
         break;
     }
 
-out:
-
-#ifdef TT_MOVE_ENABLE
-    ttMove = tte.ttMove;
-#endif // TT_MOVE_ENABLE
-
     return VALUE_UNKNOWN;
 }
 
-bool TranspositionTable::search(Key key, TTEntry &tte)
+/// TranspositionTable::search() looks up the current position in the
+/// transposition table. A slot only matches if key ^ data read back equals
+/// the key, so an entry torn by a concurrent save() is never returned.
+
+bool TranspositionTable::search(Key key, TTEntry &tte) const
 {
-    return TT.find(key, tte);
+    const Slot *slot = first_entry(key)->slot;
+
+    for (int i = 0; i < ClusterSize; ++i) {
+        const Word data = slot[i].data.load(std::memory_order_relaxed);
+        const Word check = slot[i].check.load(std::memory_order_relaxed);
+
+        if ((check ^ data) == static_cast<Word>(key) &&
+            bound_of(data) != BOUND_NONE) {
+            tte = unpack(data);
+            return true;
+        }
+    }
+
+    return false;
 }
 
-void TranspositionTable::prefetch(Key key)
+void TranspositionTable::prefetch(Key key) const
 {
-    TT.prefetchValue(key);
+    ::prefetch(static_cast<void *>(first_entry(key)));
 }
 
+/// TranspositionTable::save() stores an entry in the cluster of the key. An
+/// entry of the same key is overwritten unless it is deeper and still current.
+/// Otherwise an empty or stale slot is used, and failing that the shallowest
+/// one in the cluster is replaced.
+
 int TranspositionTable::save(Value value, Depth depth, Bound type, Key key
 #ifdef TT_MOVE_ENABLE
                              ,
-                             const Move &ttMove
+                             Move ttMove
 #endif // TT_MOVE_ENABLE
 )
 {
-    TTEntry tte {};
+    Slot *slot = first_entry(key)->slot;
+    Slot *replace = nullptr;
+    int replaceDepth = std::numeric_limits<int>::max();
+#ifdef TT_MOVE_ENABLE
+    Move oldMove = MOVE_NONE;
+#endif // TT_MOVE_ENABLE
+
+    for (int i = 0; i < ClusterSize; ++i) {
+        const Word data = slot[i].data.load(std::memory_order_relaxed);
+        const Word check = slot[i].check.load(std::memory_order_relaxed);
+        const TTEntry tte = unpack(data);
+
+        if (tte.bound() == BOUND_NONE) {
+            if (replaceDepth > std::numeric_limits<int>::min()) {
+                replace = &slot[i];
+                replaceDepth = std::numeric_limits<int>::min();
+            }
+            continue;
+        }
 
-    if (search(key, tte)) {
 #ifdef TRANSPOSITION_TABLE_FAKE_CLEAN
-        if (tte.age8 == transpositionTableAge) {
+        const bool current = tte.age8 == age8;
+#else
+        const bool current = true;
 #endif // TRANSPOSITION_TABLE_FAKE_CLEAN
-            if (tte.genBound8 != BOUND_NONE && tte.depth() > depth) {
+
+        if ((check ^ data) == static_cast<Word>(key)) {
+            if (current && tte.depth() > std::min<int>(depth, MaxDepth)) {
                 return -1;
             }
-#ifdef TRANSPOSITION_TABLE_FAKE_CLEAN
+            replace = &slot[i];
+#ifdef TT_MOVE_ENABLE
+            oldMove = tte.ttMove;
+#endif // TT_MOVE_ENABLE
+            break;
+        }
+
+        // Stale entries are as good as empty ones
+        const int slotDepth = current ? static_cast<int>(tte.depth()) :
+                                        std::numeric_limits<int>::min();
+
+        if (slotDepth < replaceDepth) {
+            replace = &slot[i];
+            replaceDepth = slotDepth;
         }
-#endif // TRANSPOSITION_TABLE_FAKE_CLEAN
     }
 
+    TTEntry tte {};
+
     tte.value8 = value;
-    tte.depth8 = depth;
+    tte.depth8 = static_cast<int8_t>(std::clamp<int>(depth, 0, MaxDepth));
     tte.genBound8 = type;
 
 #ifdef TT_MOVE_ENABLE
-    tte.ttMove = ttMove;
+    // Preserve the move of the same position when a fail-low has none
+    tte.ttMove = ttMove != MOVE_NONE ? ttMove : oldMove;
 #endif // TT_MOVE_ENABLE
 
 #ifdef TRANSPOSITION_TABLE_FAKE_CLEAN
-    tte.age8 = transpositionTableAge;
+    tte.age8 = age8;
 #endif // TRANSPOSITION_TABLE_FAKE_CLEAN
 
-    TT.insert(key, tte);
+    const Word data = pack(tte);
+
+    replace->data.store(data, std::memory_order_relaxed);
+    replace->check.store(static_cast<Word>(key) ^ data,
+                         std::memory_order_relaxed);
 
     return 0;
 }
@@ -142,19 +426,4 @@ Bound TranspositionTable::boundType(Value value, Value alpha, Value beta)
     return BOUND_EXACT;
 }
 
-void TranspositionTable::clear()
-{
-#ifdef TRANSPOSITION_TABLE_FAKE_CLEAN
-    if (transpositionTableAge == std::numeric_limits<uint8_t>::max()) {
-        debugPrintf("Clean TT\n");
-        TT.clear();
-        transpositionTableAge = 0;
-    } else {
-        transpositionTableAge++;
-    }
-#else
-    TT.clear();
-#endif // TRANSPOSITION_TABLE_FAKE_CLEAN
-}
-
 #endif /* TRANSPOSITION_TABLE_ENABLE */
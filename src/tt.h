@@ -17,19 +17,21 @@
 #ifndef TT_H_INCLUDED
 #define TT_H_INCLUDED
 
-#include "hashmap.h"
-#include "types.h"
+#include <atomic>
+#include <cstddef>
 
-using CTSL::HashMap;
+#include "types.h"
 
 #ifdef TRANSPOSITION_TABLE_ENABLE
 
-/// TTEntry struct is the 4 bytes transposition table entry, defined as below:
+/// TTEntry struct is the decoded transposition table entry. It is packed into
+/// a 32 bit data word as below:
 ///
 /// value               8 bit
-/// depth               8 bit
-/// bound type          8 bit
-/// age                 8 bit
+/// depth               5 bit
+/// bound type          2 bit
+/// age                 7 bit (TRANSPOSITION_TABLE_FAKE_CLEAN only)
+/// move               10 bit (TT_MOVE_ENABLE only)
 
 struct TTEntry
 {
@@ -45,7 +47,7 @@ struct TTEntry
     Bound bound() const noexcept { return static_cast<Bound>(genBound8); }
 
 #ifdef TT_MOVE_ENABLE
-    Move tt_move() const noexcept { return (Move)(ttMove); }
+    Move tt_move() const noexcept { return ttMove; }
 #endif // TT_MOVE_ENABLE
 
 private:
@@ -62,41 +64,99 @@ private:
 #endif // TT_MOVE_ENABLE
 };
 
+/// TranspositionTable is an array of Cluster, of size clusterCount. Each
+/// cluster fills one cache line and holds ClusterSize slots. A slot packs an
+/// entry into a single data word and stores key ^ data next to it, so probes
+/// and stores need no lock: a reader racing with a writer sees a key
+/// mismatch and simply treats the slot as empty.
+
 class TranspositionTable
 {
+#ifdef TRANSPOSITION_TABLE_64BIT_KEY
+    using Word = uint64_t;
+#else
+    using Word = uint32_t;
+#endif
+
+    // Bit layout of the data word, see TTEntry
+    static constexpr int DepthShift = 8, BoundShift = 13, AgeShift = 15,
+                         MoveShift = 22;
+    static constexpr int MaxDepth = (1 << (BoundShift - DepthShift)) - 1;
+    static constexpr int MaxAge = (1 << (MoveShift - AgeShift)) - 1;
+
+    struct Slot
+    {
+        std::atomic<Word> check;
+        std::atomic<Word> data;
+    };
+
+    static constexpr int ClusterSize = 64 / sizeof(Slot);
+
+    struct alignas(64) Cluster
+    {
+        Slot slot[ClusterSize];
+    };
+
+    static_assert(sizeof(Cluster) == 64, "Unexpected Cluster size");
+
 public:
-    static bool search(Key key, TTEntry &tte);
+    TranspositionTable();
+    explicit TranspositionTable(size_t mbSize);
+    ~TranspositionTable();
+
+    TranspositionTable(const TranspositionTable &) = delete;
+    TranspositionTable &operator=(const TranspositionTable &) = delete;
+
+    bool search(Key key, TTEntry &tte) const;
 
-    static Value probe(Key key, Depth depth, Value alpha, Value beta,
-                       Bound &type
+    Value probe(Key key, Depth depth, Value alpha, Value beta, Bound &type
 #ifdef TT_MOVE_ENABLE
-                       ,
-                       Move &ttMove
+                ,
+                Move &ttMove
 #endif // TT_MOVE_ENABLE
-    );
+    ) const;
 
-    static int save(Value value, Depth depth, Bound type, Key key
+    int save(Value value, Depth depth, Bound type, Key key
 #ifdef TT_MOVE_ENABLE
-                    ,
-                    const Move &ttMove
+             ,
+             Move ttMove
 #endif // TT_MOVE_ENABLE
     );
 
     static Bound boundType(Value value, Value alpha, Value beta);
 
-    static void clear();
+    void new_search();
+    void resize(size_t mbSize);
+    void clear();
+    int hashfull() const;
 
-    static void prefetch(Key key);
+    void prefetch(Key key) const;
 
 private:
-    friend struct TTEntry;
-};
+    Cluster *first_entry(Key key) const;
+
+    static Word pack(const TTEntry &tte);
+    static TTEntry unpack(Word data);
+    static Bound bound_of(Word data);
+
+#ifdef TT_MOVE_ENABLE
+    static Word pack_move(Move m);
+    static Move unpack_move(Word bits);
+#endif // TT_MOVE_ENABLE
 
-extern HashMap<Key, TTEntry> TT;
+    size_t clusterCount {0};
+    Cluster *table {nullptr};
 
 #ifdef TRANSPOSITION_TABLE_FAKE_CLEAN
-extern uint8_t transpositionTableAge;
+    uint8_t age8 {0};
 #endif // TRANSPOSITION_TABLE_FAKE_CLEAN
+};
+
+/// Default transposition table size in MB. It matches the footprint of the
+/// former fixed-size table and is what the GUI gets without any UCI options.
+constexpr size_t TRANSPOSITION_TABLE_DEFAULT_MB = 128;
+
+extern TranspositionTable TT;
 
 #endif // TRANSPOSITION_TABLE_ENABLE
 
@@ -14,7 +14,11 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
+#include <cstring>
+#include <iostream>
 #include <sstream>
+#include <utility>
 #include <vector>
 
 #include "thread.h"
@@ -25,6 +29,11 @@
 #include "command_channel.h"
 #endif
 
+#if defined(GABOR_MALOM_PERFECT_AI) && !defined(FLUTTER_UI)
+#include "option.h"
+#include "perfect/perfect_adaptor.h"
+#endif
+
 using std::cin;
 using std::istream;
 using std::istringstream;
@@ -113,13 +122,41 @@ void setoption(istringstream &is)
 // the thinking time and other parameters from the input string, then starts
 // the search.
 
-void go(Position *pos)
+void go(Position *pos, istringstream &is)
 {
+    Search::LimitsType limits;
+    string token;
+    bool ponderMode = false;
+
+    limits.startTime = now(); // As early as possible!
+
+    while (is >> token)
+        if (token == "wtime")
+            is >> limits.time[WHITE];
+        else if (token == "btime")
+            is >> limits.time[BLACK];
+        else if (token == "winc")
+            is >> limits.inc[WHITE];
+        else if (token == "binc")
+            is >> limits.inc[BLACK];
+        else if (token == "movestogo")
+            is >> limits.movestogo;
+        else if (token == "depth")
+            is >> limits.depth;
+        else if (token == "nodes")
+            is >> limits.nodes;
+        else if (token == "movetime")
+            is >> limits.movetime;
+        else if (token == "infinite")
+            limits.infinite = 1;
+        else if (token == "ponder")
+            ponderMode = true;
+
 #ifdef UCI_AUTO_RE_GO
 begin:
 #endif
 
-    Threads.start_thinking(pos);
+    Threads.start_thinking(pos, limits, ponderMode);
 
     if (pos->get_phase() == Phase::gameOver) {
 #ifdef UCI_AUTO_RESTART
@@ -143,6 +180,141 @@ begin:
 #endif
 }
 
+// bench() is called when engine receives the "bench" command. Firstly a list
+// of UCI commands is setup according to bench parameters, then it is run one
+// by one printing a summary at the end. The total node count is deterministic
+// for a given depth and algorithm as long as a single thread is used, so it
+// serves as the signature of the search. The rule and the options set by the
+// list are restored afterwards.
+
+void bench(Position *pos, istream &args)
+{
+    string token;
+    uint64_t nodes = 0, ttProbes = 0, ttHits = 0;
+    TimePoint elapsed = 0;
+    int cnt = 1;
+
+    const Rule savedRule = rule;
+    const vector<string> list = setup_bench(pos, args);
+    const auto num = std::count_if(list.begin(), list.end(),
+                                   [](const string &s) {
+                                       return s.find("go") == 0;
+                                   });
+
+    // Current values of the options the list sets, in order
+    vector<std::pair<string, string>> savedOptions;
+
+    for (const auto &cmd : list) {
+        istringstream is(cmd);
+        string name;
+        is >> skipws >> token;
+
+        if (token != "setoption") {
+            continue;
+        }
+
+        is >> token; // Consume "name" token
+
+        while (is >> token && token != "value")
+            name += (name.empty() ? "" : " ") + token;
+
+        if (Options.count(name) &&
+            std::none_of(savedOptions.begin(), savedOptions.end(),
+                         [&](const auto &o) { return o.first == name; })) {
+            savedOptions.emplace_back(name, string(Options[name]));
+        }
+    }
+
+    for (const auto &cmd : list) {
+        istringstream is(cmd);
+        is >> skipws >> token;
+
+        if (token == "go") {
+            std::cerr << "\nPosition: " << cnt++ << '/' << num << " ("
+                      << pos->fen() << ")" << std::endl;
+
+            const TimePoint start = now();
+            go(pos, is);
+            Threads.main()->wait_for_search_finished();
+            elapsed += now() - start;
+
+            nodes += Threads.nodes_searched();
+            ttProbes += Threads.tt_probes();
+            ttHits += Threads.tt_hits();
+        } else if (token == "rule") {
+            // Switch to one of the predefined rules and rebuild the rule
+            // dependent tables
+            int r;
+            is >> r;
+            set_rule(r);
+            pos->reset();
+            std::cerr << "\nRule: " << rule.name << std::endl;
+        } else if (token == "setoption") {
+            setoption(is);
+        } else if (token == "position") {
+            position(pos, is);
+        } else if (token == "ucinewgame") {
+            Search::clear();
+        }
+    }
+
+    rule = savedRule;
+
+    for (const auto &[name, value] : savedOptions) {
+        if (string(Options[name]) != value) {
+            Options[name] = value;
+        }
+    }
+
+    pos->reset();
+    pos->set(StartFEN, Threads.main());
+    Threads.main()->us = pos->sideToMove;
+
+    elapsed += 1; // Ensure positivity to avoid a 'divide by zero'
+
+    std::cerr << "\n==========================="
+              << "\nTotal time (ms) : " << elapsed
+              << "\nNodes searched  : " << nodes
+              << "\nNodes/second    : " << 1000 * nodes / elapsed
+              << "\nTT hit rate (%) : "
+              << (ttProbes ? 100 * ttHits / ttProbes : 0) << std::endl;
+}
+
+#if defined(GABOR_MALOM_PERFECT_AI) && !defined(FLUTTER_UI)
+// solve() is called when engine receives the "solve" command. It generates
+// the perfect database of the current rule, by default in the perfect
+// database path with the number of search threads.
+
+void solve(istream &is)
+{
+    string path = gameOptions.getPerfectDatabasePath();
+    int threads = static_cast<int>(Options["Threads"]);
+
+    is >> path >> threads;
+
+    const bool solved = perfect_solve(path, threads);
+
+    sync_cout << "info string " << (solved ? "solved" : "failed") << sync_endl;
+}
+
+// verify() is called when engine receives the "verify" command. It checks
+// the perfect database of the current rule, by default in the perfect
+// database path with the number of search threads.
+
+void verify(istream &is)
+{
+    string path = gameOptions.getPerfectDatabasePath();
+    int threads = static_cast<int>(Options["Threads"]);
+
+    is >> path >> threads;
+
+    const bool verified = perfect_verify(path, threads);
+
+    sync_cout << "info string " << (verified ? "verified" : "failed")
+              << sync_endl;
+}
+#endif
+
 } // namespace
 
 /// UCI::loop() waits for a command from stdin, parses it and calls the
@@ -239,13 +411,21 @@ void UCI::loop(int argc, char *argv[])
         else if (token == "setoption")
             setoption(is);
         else if (token == "go")
-            go(pos);
+            go(pos, is);
         else if (token == "position")
             position(pos, is);
         else if (token == "ucinewgame")
             Search::clear();
         else if (token == "isready")
             sync_cout << "readyok" << sync_endl;
+        else if (token == "bench")
+            bench(pos, is);
+#if defined(GABOR_MALOM_PERFECT_AI) && !defined(FLUTTER_UI)
+        else if (token == "solve")
+            solve(is);
+        else if (token == "verify")
+            verify(is);
+#endif
 
         // Additional custom non-UCI commands, mainly for debugging.
         // Do not use these commands during a search!
@@ -316,6 +496,38 @@ string UCI::move(Move m)
     return move;
 }
 
+/// UCI::pv() formats the "info" line sent after a completed iteration. The
+/// node counts are summed over the whole pool, while the selective depth and
+/// the principal variation come from the given thread.
+
+string UCI::pv(const Thread *th, Depth depth)
+{
+    stringstream ss;
+    const TimePoint elapsed = now() - th->startTime + 1;
+    const uint64_t nodesSearched = Threads.nodes_searched();
+
+    ss << "info"
+       << " depth " << static_cast<int>(depth) << " seldepth "
+       << th->selDepth.load(std::memory_order_relaxed) << " nodes "
+       << nodesSearched << " nps " << nodesSearched * 1000 / elapsed
+       << " tbhits " << Threads.tb_hits();
+
+#ifdef TRANSPOSITION_TABLE_ENABLE
+    ss << " hashfull " << TT.hashfull();
+#endif // TRANSPOSITION_TABLE_ENABLE
+
+    ss << " time " << elapsed << " pv";
+
+    if (th->pv.empty()) {
+        ss << " " << move(th->bestMove);
+    }
+
+    for (const Move m : th->pv)
+        ss << " " << move(m);
+
+    return ss.str();
+}
+
 /// UCI::to_move() converts a string representing a move in coordinate notation
 /// to the corresponding legal Move, if any.
 
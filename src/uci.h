@@ -24,6 +24,7 @@
 #include "types.h"
 
 class Position;
+class Thread;
 
 namespace UCI {
 
@@ -70,6 +71,7 @@ void loop(int argc, char *argv[]);
 std::string value(Value v);
 std::string square(Square s);
 std::string move(Move m);
+std::string pv(const Thread *th, Depth depth);
 Move to_move(Position *pos, const std::string &str);
 
 } // namespace UCI
@@ -74,6 +74,11 @@ static void on_algorithm(const Option &o)
     gameOptions.setAlgorithm(static_cast<int>(o));
 }
 
+static void on_mctsRandomPlayout(const Option &o)
+{
+    gameOptions.setMctsRandomPlayout(static_cast<bool>(o));
+}
+
 static void on_usePerfectDatabase(const Option &o)
 {
     gameOptions.setUsePerfectDatabase(static_cast<bool>(o));
@@ -84,6 +89,26 @@ static void on_perfectDatabasePath(const Option &o)
     gameOptions.setPerfectDatabasePath(static_cast<std::string>(o));
 }
 
+static void on_perfectDatabaseMemory(const Option &o)
+{
+    gameOptions.setPerfectDatabaseMemory(static_cast<int>(o));
+}
+
+static void on_perfectDatabasePrefetch(const Option &o)
+{
+    gameOptions.setPerfectDatabasePrefetch(static_cast<bool>(o));
+}
+
+static void on_perfectDatabaseProbeDepth(const Option &o)
+{
+    gameOptions.setPerfectDatabaseProbeDepth(static_cast<int>(o));
+}
+
+static void on_perfectDatabaseProbeLimit(const Option &o)
+{
+    gameOptions.setPerfectDatabaseProbeLimit(static_cast<int>(o));
+}
+
 static void on_drawOnHumanExperience(const Option &o)
 {
     gameOptions.setDrawOnHumanExperience(o);
@@ -197,7 +222,7 @@ void init(OptionsMap &o)
                                      "Both",
                                      "Both");
     o["Threads"] << Option(1, 1, 512, on_threads);
-    o["Hash"] << Option(16, 1, MaxHashMB, on_hash_size);
+    o["Hash"] << Option(128, 1, MaxHashMB, on_hash_size);
     o["Clear Hash"] << Option(on_clear_hash);
     o["Ponder"] << Option(false);
     o["MultiPV"] << Option(1, 1, 500);
@@ -213,8 +238,16 @@ void init(OptionsMap &o)
 
     o["Shuffling"] << Option(true, on_random_move);
     o["Algorithm"] << Option(2, 0, 4, on_algorithm);
+    o["MctsRandomPlayout"] << Option(false, on_mctsRandomPlayout);
     o["UsePerfectDatabase"] << Option(false, on_usePerfectDatabase);
     o["PerfectDatabasePath"] << Option(".", on_perfectDatabasePath);
+    o["PerfectDatabaseMemory"] << Option(1024, 0, 65536,
+                                         on_perfectDatabaseMemory);
+    o["PerfectDatabasePrefetch"] << Option(false, on_perfectDatabasePrefetch);
+    o["PerfectDatabaseProbeDepth"] << Option(1, 1, 100,
+                                             on_perfectDatabaseProbeDepth);
+    o["PerfectDatabaseProbeLimit"] << Option(24, 0, 24,
+                                             on_perfectDatabaseProbeLimit);
     o["DrawOnHumanExperience"] << Option(true, on_drawOnHumanExperience);
     o["ConsiderMobility"] << Option(true, on_considerMobility);
     o["DeveloperMode"] << Option(true, on_developerMode);
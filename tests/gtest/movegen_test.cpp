@@ -0,0 +1,223 @@
+// This file is part of Sanmill.
+// Copyright (C) 2019-2024 The Sanmill developers (see AUTHORS file)
+//
+// Sanmill is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Sanmill is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <string>
+
+#include "bitboard.h"
+#include "misc.h"
+#include "movegen.h"
+#include "position.h"
+#include "rule.h"
+
+namespace {
+
+// The board walking generator the bitboard one replaced. It selects the
+// pieces on the position, so it works on a copy.
+
+ExtMove *old_generate_move(Position &pos, ExtMove *moveList)
+{
+    ExtMove *cur = moveList;
+
+    for (auto i = SQUARE_NB - 1; i >= 0; i--) {
+        const Square from = MoveList<LEGAL>::movePriorityList[i];
+
+        if (!pos.select_piece(from)) {
+            continue;
+        }
+
+        if (rule.mayFly && pos.piece_on_board_count(pos.side_to_move()) <=
+                               rule.flyPieceCount) {
+            for (Square to = SQ_BEGIN; to < SQ_END; ++to) {
+                if (!pos.get_board()[to]) {
+                    *cur++ = make_move(from, to);
+                }
+            }
+        } else {
+            for (auto direction = MD_BEGIN; direction < MD_NB; ++direction) {
+                const Square to =
+                    MoveList<LEGAL>::adjacentSquares[from][direction];
+                if (to && !pos.get_board()[to]) {
+                    *cur++ = make_move(from, to);
+                }
+            }
+        }
+    }
+
+    return cur;
+}
+
+ExtMove *old_generate_place(Position &pos, ExtMove *moveList)
+{
+    ExtMove *cur = moveList;
+
+    for (auto s : MoveList<LEGAL>::movePriorityList) {
+        if (!pos.get_board()[s]) {
+            *cur++ = static_cast<Move>(s);
+        }
+    }
+
+    return cur;
+}
+
+ExtMove *old_generate_remove(Position &pos, ExtMove *moveList)
+{
+    const Color us = pos.side_to_move();
+    const Color them = ~us;
+
+    ExtMove *cur = moveList;
+
+    if (pos.is_stalemate_removal()) {
+        for (auto i = SQUARE_NB - 1; i >= 0; i--) {
+            Square s = MoveList<LEGAL>::movePriorityList[i];
+            if (pos.get_board()[s] & make_piece(them)) {
+                if (pos.is_adjacent_to(s, us) == true) {
+                    *cur++ = static_cast<Move>(-s);
+                }
+            }
+        }
+
+        return cur;
+    }
+
+    if (pos.is_all_in_mills(them)) {
+        for (auto i = SQUARE_NB - 1; i >= 0; i--) {
+            Square s = MoveList<LEGAL>::movePriorityList[i];
+            if (pos.get_board()[s] & make_piece(them)) {
+                *cur++ = static_cast<Move>(-s);
+            }
+        }
+        return cur;
+    }
+
+    for (auto i = SQUARE_NB - 1; i >= 0; i--) {
+        const Square s = MoveList<LEGAL>::movePriorityList[i];
+        if (pos.get_board()[s] & make_piece(them)) {
+            if (rule.mayRemoveFromMillsAlways ||
+                !pos.potential_mills_count(s, NOBODY)) {
+                *cur++ = static_cast<Move>(-s);
+            }
+        }
+    }
+
+    return cur;
+}
+
+ExtMove *old_generate_legal(Position &pos, ExtMove *moveList)
+{
+    switch (pos.get_action()) {
+    case Action::select:
+    case Action::place:
+        if (pos.get_phase() == Phase::placing ||
+            pos.get_phase() == Phase::ready) {
+            return old_generate_place(pos, moveList);
+        }
+
+        if (pos.get_phase() == Phase::moving) {
+            return old_generate_move(pos, moveList);
+        }
+
+        break;
+
+    case Action::remove:
+        return old_generate_remove(pos, moveList);
+
+    case Action::none:
+        break;
+    }
+
+    return moveList;
+}
+
+// The kinds of positions the suite has to cover
+enum Kind { PLACING, MOVING, FLYING, REMOVING, STALEMATE_REMOVING, KIND_NB };
+
+Kind kind_of(const Position &pos)
+{
+    if (pos.get_action() == Action::remove) {
+        return pos.is_stalemate_removal() ? STALEMATE_REMOVING : REMOVING;
+    }
+
+    if (pos.get_phase() != Phase::moving) {
+        return PLACING;
+    }
+
+    return rule.mayFly && pos.piece_on_board_count(pos.side_to_move()) <=
+                              rule.flyPieceCount ?
+               FLYING :
+               MOVING;
+}
+
+// Compare the generators, move for move and in the same order, on the
+// positions of random games under every rule
+TEST(MovegenTest, legalMatchesOldGenerator)
+{
+    constexpr int Games = 100;
+    constexpr int MaxPlies = 300;
+
+    Bitboards::init();
+    Position::init();
+
+    PRNG rng(1070372);
+    int seen[KIND_NB] {0};
+
+    for (int r = 0; r < N_RULES; r++) {
+        SCOPED_TRACE(RULES[r].name);
+        set_rule(r);
+
+        for (int g = 0; g < Games; g++) {
+            Position pos;
+            pos.reset();
+            pos.start();
+
+            for (int ply = 0;
+                 ply < MaxPlies && pos.get_phase() != Phase::gameOver; ply++) {
+                Position copy = pos;
+                ExtMove oldList[MAX_MOVES];
+                ExtMove *oldEnd = old_generate_legal(copy, oldList);
+
+                const MoveList<LEGAL> moves(pos);
+
+                ASSERT_EQ(moves.size(), static_cast<size_t>(oldEnd - oldList))
+                    << pos.fen();
+                for (size_t i = 0; i < moves.size(); i++) {
+                    ASSERT_EQ(moves.begin()[i].move, oldList[i].move)
+                        << pos.fen();
+                }
+
+                seen[kind_of(pos)]++;
+
+                if (moves.size() == 0) {
+                    break;
+                }
+
+                pos.do_move(
+                    moves.begin()[rng.rand<uint64_t>() % moves.size()].move);
+            }
+        }
+    }
+
+    set_rule(0);
+
+    EXPECT_GT(seen[PLACING], 0);
+    EXPECT_GT(seen[MOVING], 0);
+    EXPECT_GT(seen[FLYING], 0);
+    EXPECT_GT(seen[REMOVING], 0);
+    EXPECT_GT(seen[STALEMATE_REMOVING], 0);
+}
+
+} // namespace
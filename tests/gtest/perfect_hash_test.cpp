@@ -0,0 +1,212 @@
+// This file is part of Sanmill.
+// Copyright (C) 2019-2024 The Sanmill developers (see AUTHORS file)
+//
+// Sanmill is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Sanmill is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "config.h"
+
+#ifdef GABOR_MALOM_PERFECT_AI
+
+#include "perfect/perfect_common.h"
+#include "perfect/perfect_hash.h"
+#include "perfect/perfect_symmetries.h"
+
+namespace {
+
+// The hash tables as they were before they were indexed by the colex rank:
+// direct lookups by the 24 bit board, built in the same order
+struct OldTables
+{
+    OldTables(int W, int B)
+        : f_lookup(1 << 24, -1)
+        , f_sym_lookup(1 << 24, 0)
+        , g_lookup(1 << (24 - W), -1)
+    {
+        int c = 0;
+        for (int w = (1 << W) - 1; w < 1 << 24; w = next_choose(w))
+            if (f_lookup[w] == -1) {
+                for (int i = 0; i < 16; i++) {
+                    auto sw = sym24(i, w);
+                    f_lookup[sw] = c;
+                    f_sym_lookup[sw] = inv[i];
+                }
+                c++;
+            }
+        f_count = c;
+
+        f_inv_lookup.resize(f_count);
+        std::vector<int> ws;
+        for (int w = (1 << W) - 1; w < 1 << 24; w = next_choose(w))
+            ws.push_back(w);
+        std::reverse(ws.begin(), ws.end());
+        for (int w : ws)
+            f_inv_lookup[f_lookup[w]] = w;
+
+        for (int b = (1 << B) - 1; b < 1 << (24 - W); b = next_choose(b)) {
+            g_lookup[b] = static_cast<int>(g_inv_lookup.size());
+            g_inv_lookup.push_back(b);
+        }
+    }
+
+    int g_count() const { return static_cast<int>(g_inv_lookup.size()); }
+
+    int index(board a) const
+    {
+        a = sym48(f_sym_lookup[a & mask24], a);
+        return f_lookup[a & mask24] * g_count() + g_lookup[collapse(a)];
+    }
+
+    board inv_hash(int h) const
+    {
+        const int f = h / g_count(), g = h % g_count();
+        return uncollapse(f_inv_lookup[f] |
+                          (static_cast<board>(g_inv_lookup[g]) << 24));
+    }
+
+    int f_count {0};
+    std::vector<int> f_lookup;
+    std::vector<int8_t> f_sym_lookup;
+    std::vector<int> f_inv_lookup;
+    std::vector<int> g_lookup;
+    std::vector<int> g_inv_lookup;
+};
+
+class PerfectHashTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        init_sym_lookuptables();
+
+        savedPath = sec_val_path;
+        dir = std::filesystem::temp_directory_path() / "sanmill_hash_test";
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+        sec_val_path = dir.string();
+
+        HashTables::release();
+    }
+
+    void TearDown() override
+    {
+        HashTables::release();
+        sec_val_path = savedPath;
+        std::filesystem::remove_all(dir);
+    }
+
+    // Compare the tables of W, indexed by the colex rank, with the old ones
+    static void expect_same_tables(const HashTables &t, const OldTables &old,
+                                   int W)
+    {
+        ASSERT_EQ(t.f_count, old.f_count);
+
+        int rank = 0;
+        for (int w = (1 << W) - 1; w < 1 << 24; w = next_choose(w), rank++) {
+            ASSERT_LT(rank, t.n);
+            EXPECT_EQ(t.f_lookup[rank], old.f_lookup[w]) << "w = " << w;
+            EXPECT_EQ(t.f_sym_lookup[rank], old.f_sym_lookup[w])
+                << "w = " << w;
+        }
+        EXPECT_EQ(rank, t.n);
+
+        for (int f = 0; f < t.f_count; f++) {
+            EXPECT_EQ(t.f_inv_lookup[f], old.f_inv_lookup[f]) << "f = " << f;
+        }
+    }
+
+    std::string savedPath;
+    std::filesystem::path dir;
+};
+
+TEST_F(PerfectHashTest, tablesMatchOldTables)
+{
+    for (int W : {0, 1, 3, 4, 8, 12}) {
+        SCOPED_TRACE("W = " + std::to_string(W));
+
+        const OldTables old(W, 0);
+
+        // Built, then mapped from the file written by the build
+        expect_same_tables(*HashTables::get(W), old, W);
+        HashTables::release();
+        expect_same_tables(*HashTables::get(W), old, W);
+    }
+}
+
+TEST_F(PerfectHashTest, corruptedTablesAreRebuilt)
+{
+    const int W = 4;
+    const OldTables old(W, 0);
+
+    HashTables::get(W);
+    HashTables::release();
+
+    // Flip a byte of f_lookup in the saved file
+    const auto file = dir / ("hash_" + std::to_string(W) + ".tbl");
+    {
+        std::fstream f(file, std::ios::in | std::ios::out | std::ios::binary);
+        ASSERT_TRUE(f.is_open());
+        f.seekg(64);
+        const char c = static_cast<char>(f.get());
+        f.seekp(64);
+        f.put(static_cast<char>(c ^ 1));
+    }
+
+    expect_same_tables(*HashTables::get(W), old, W);
+    HashTables::release();
+    expect_same_tables(*HashTables::get(W), old, W);
+
+    // The rebuilt tables replaced the file, and no temporary file is left
+    for (const auto &e : std::filesystem::directory_iterator(dir)) {
+        EXPECT_EQ(e.path().filename(), file.filename());
+    }
+}
+
+TEST_F(PerfectHashTest, hashMatchesOldHash)
+{
+    const int sectors[][2] = {{3, 3}, {4, 3}, {3, 4}, {2, 5}, {12, 1}};
+
+    for (const auto &wb : sectors) {
+        const int W = wb[0], B = wb[1];
+        SCOPED_TRACE("W = " + std::to_string(W) + ", B = " + std::to_string(B));
+
+        const OldTables old(W, B);
+        Hash hash(W, B, nullptr);
+
+        ASSERT_EQ(hash.hash_count, old.f_count * old.g_count());
+
+        for (int h = 0; h < hash.hash_count; h++) {
+            const board a = hash.inv_hash(h);
+            ASSERT_EQ(a, old.inv_hash(h)) << "h = " << h;
+            ASSERT_EQ(hash.index(a), old.index(a)) << "h = " << h;
+            ASSERT_EQ(hash.index(a), h) << "h = " << h;
+
+            // A symmetric board lands in the same orbit
+            const board s = sym48(h % 16, a);
+            ASSERT_EQ(hash.index(s), old.index(s)) << "h = " << h;
+        }
+    }
+}
+
+} // namespace
+
+#endif // GABOR_MALOM_PERFECT_AI
@@ -0,0 +1,316 @@
+// This file is part of Sanmill.
+// Copyright (C) 2019-2024 The Sanmill developers (see AUTHORS file)
+//
+// Sanmill is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Sanmill is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "config.h"
+
+#ifdef GABOR_MALOM_PERFECT_AI
+
+#include "misc.h"
+#include "option.h"
+#include "perfect/perfect_adaptor.h"
+#include "perfect/perfect_api.h"
+#include "perfect/perfect_common.h"
+#include "perfect/perfect_game_state.h"
+#include "perfect/perfect_player.h"
+#include "perfect/perfect_rules.h"
+#include "perfect/perfect_solver.h"
+#include "rule.h"
+
+extern int max_ksz;
+
+namespace {
+
+// Only the sectors with at most this many stones per side are solved, which
+// takes about a second per rule
+constexpr int SolvedStones = 3;
+
+// Solves the small sectors of each rule once into a temporary directory, and
+// opens them for the perfect player
+class PerfectSolverTest : public ::testing::TestWithParam<int>
+{
+protected:
+    static void SetUpTestCase()
+    {
+        savedPath = gameOptions.getPerfectDatabasePath();
+        savedSecValPath = sec_val_path;
+    }
+
+    static void TearDownTestCase()
+    {
+        perfect_exit();
+        gameOptions.setPerfectDatabasePath(savedPath);
+        sec_val_path = savedSecValPath;
+        for (const auto &d : solved) {
+            std::filesystem::remove_all(d.second);
+        }
+        solved.clear();
+        set_rule(0);
+    }
+
+    void SetUp() override
+    {
+        set_rule(GetParam());
+
+        if (!solved.count(GetParam())) {
+            const auto dir = std::filesystem::temp_directory_path() /
+                             ("sanmill_solver_test_" +
+                              std::to_string(GetParam()));
+            std::filesystem::remove_all(dir);
+            std::filesystem::create_directories(dir);
+            solved[GetParam()] = dir;
+
+            perfect_exit();
+            perfect_init();
+            max_ksz = SolvedStones;
+            ASSERT_TRUE(solve_database(dir.string(), 2));
+        }
+
+        gameOptions.setPerfectDatabasePath(solved[GetParam()].string());
+        MalomSolutionAccess::initializeIfNeeded();
+
+        pp = std::make_unique<PerfectPlayer>();
+    }
+
+    void TearDown() override { pp.reset(); }
+
+    // A position of the moving phase, all stones placed
+    static GameState moving(const std::vector<int> &white,
+                            const std::vector<int> &black)
+    {
+        GameState s;
+
+        for (int i : white) {
+            s.T[i] = 0;
+        }
+        for (int i : black) {
+            s.T[i] = 1;
+        }
+
+        s.stoneCount = {static_cast<int>(white.size()),
+                        static_cast<int>(black.size())};
+        s.setStoneCount = {Rules::maxKSZ, Rules::maxKSZ};
+        s.phase = 2;
+        s.sideToMove = 0;
+        s.moveCount = 10;
+
+        return s;
+    }
+
+    static bool share_mill(int a, int b)
+    {
+        for (const auto &m : Rules::millPos) {
+            if (std::count(std::begin(m), std::end(m), a) &&
+                std::count(std::begin(m), std::end(m), b)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // n empty squares outside of used, no two of them on a line
+    static std::vector<int> scattered(int n, std::vector<int> used)
+    {
+        std::vector<int> r;
+
+        for (int i = 0; i < 24 && static_cast<int>(r.size()) < n; i++) {
+            if (std::count(used.begin(), used.end(), i) ||
+                std::any_of(r.begin(), r.end(),
+                            [i](int j) { return share_mill(i, j); })) {
+                continue;
+            }
+            r.push_back(i);
+        }
+
+        return r;
+    }
+
+    // The moves of s and their values, in the same order
+    std::vector<Wrappers::gui_eval_elem2> move_values(const GameState &s,
+                                                      AdvancedMoveList &ms)
+    {
+        pp->getMoveList(s, ms);
+
+        std::vector<Wrappers::gui_eval_elem2> vals(
+            ms.size(), Wrappers::gui_eval_elem2::min_value(nullptr));
+        pp->moveValues(s, ms, vals.data());
+
+        return vals;
+    }
+
+    inline static std::string savedPath;
+    inline static std::string savedSecValPath;
+    inline static std::map<int, std::filesystem::path> solved;
+
+    std::unique_ptr<PerfectPlayer> pp;
+};
+
+// With three stones each, the side to move flies into its open mill and wins
+TEST_P(PerfectSolverTest, closingAMillWins)
+{
+    const auto &line = Rules::millPos[0];
+    std::vector<int> white {line[0], line[1]};
+    std::vector<int> used {line[0], line[1], line[2]};
+    white.push_back(scattered(1, used)[0]);
+    used.push_back(white.back());
+    const std::vector<int> black = scattered(3, used);
+    ASSERT_EQ(black.size(), 3u);
+
+    GameState s = moving(white, black);
+    ASSERT_EQ(s.setOverAndCheckValidSetup(), "");
+
+    EXPECT_EQ(pp->eval(s).outcome(), 1);
+
+    AdvancedMoveList ms;
+    auto vals = move_values(s, ms);
+    ASSERT_FALSE(ms.empty());
+
+    int wins = 0;
+    for (size_t i = 0; i < ms.size(); i++) {
+        if (ms[i].to == line[2] && ms[i].withTaking) {
+            EXPECT_EQ(vals[i].outcome(), 1);
+            EXPECT_EQ(vals[i].steps(), 1);
+        }
+        wins += vals[i].outcome() == 1;
+    }
+    EXPECT_GT(wins, 0);
+}
+
+// Against two open mills of the opponent, the side to move blocks one of them
+// and loses
+TEST_P(PerfectSolverTest, doubleThreatLoses)
+{
+    const auto &a = Rules::millPos[0];
+    const auto &b = Rules::millPos[1];
+    ASSERT_EQ(a[2], b[0]);
+
+    // The stone on the shared corner and one more on each line
+    const std::vector<int> black {a[1], a[2], b[1]};
+    const std::vector<int> white =
+        scattered(3, {a[0], a[1], a[2], b[1], b[2]});
+    ASSERT_EQ(white.size(), 3u);
+
+    GameState s = moving(white, black);
+    ASSERT_EQ(s.setOverAndCheckValidSetup(), "");
+
+    EXPECT_EQ(pp->eval(s).outcome(), -1);
+
+    AdvancedMoveList ms;
+    for (const auto &v : move_values(s, ms)) {
+        EXPECT_EQ(v.outcome(), -1);
+    }
+}
+
+// The value of a position is the value of its best move, on random positions
+// of the solved sectors, in both phases
+TEST_P(PerfectSolverTest, evalIsBestMoveValue)
+{
+    PRNG rng(1070372);
+    int checked = 0;
+
+    for (int k = 0; k < 20000 && checked < 2000; k++) {
+        int sq[24];
+        for (int i = 0; i < 24; i++) {
+            sq[i] = i;
+        }
+        for (int i = 23; i > 0; i--) {
+            std::swap(sq[i], sq[rng.rand<uint64_t>() % (i + 1)]);
+        }
+
+        // White places first, so in the placing phase black has as many
+        // stones left to place, or one more when it is to move
+        const int w = rng.rand<uint64_t>() % (SolvedStones + 1);
+        const int b = rng.rand<uint64_t>() % (SolvedStones + 1);
+        const int wf = rng.rand<uint64_t>() % (SolvedStones - w + 1);
+        const int side = rng.rand<uint64_t>() % 2;
+        const int bf = wf + side;
+        if (b + bf > SolvedStones) {
+            continue;
+        }
+
+        GameState s;
+        for (int i = 0; i < w; i++) {
+            s.T[sq[i]] = 0;
+        }
+        for (int i = w; i < w + b; i++) {
+            s.T[sq[i]] = 1;
+        }
+        s.stoneCount = {w, b};
+        s.setStoneCount = {Rules::maxKSZ - wf, Rules::maxKSZ - bf};
+        s.phase = wf + bf ? 1 : 2;
+        s.sideToMove = wf + bf ? side : static_cast<int>(
+                                            rng.rand<uint64_t>() % 2);
+        s.moveCount = 10;
+
+        if (s.setOverAndCheckValidSetup() != "" || s.over) {
+            continue;
+        }
+
+        AdvancedMoveList ms;
+        auto vals = move_values(s, ms);
+        if (ms.empty()) {
+            continue;
+        }
+
+        auto e = pp->eval(s);
+        auto best = *std::max_element(vals.begin(), vals.end());
+        ASSERT_EQ(e.toString(), best.toString()) << "position " << k;
+
+        checked++;
+    }
+
+    EXPECT_GT(checked, 1000);
+}
+
+// Nine Men's Morris and Lasker Morris
+INSTANTIATE_TEST_CASE_P(Rules, PerfectSolverTest, ::testing::Values(0, 3));
+
+// The rules the database cannot hold are refused before anything is written
+TEST(PerfectSolveTest, unsupportedRulesAreRefused)
+{
+    const auto dir = std::filesystem::temp_directory_path() /
+                     "sanmill_solver_test_unsupported";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    for (int r = 0; r < N_RULES; r++) {
+        SCOPED_TRACE(RULES[r].name);
+        set_rule(r);
+
+        // Nine Men's Morris, Twelve Men's Morris and Lasker Morris only
+        if (r == 0 || r == 1 || r == 3) {
+            continue;
+        }
+
+        EXPECT_FALSE(perfect_solve(dir.string(), 2));
+        EXPECT_TRUE(std::filesystem::is_empty(dir));
+    }
+
+    set_rule(0);
+    std::filesystem::remove_all(dir);
+}
+
+} // namespace
+
+#endif // GABOR_MALOM_PERFECT_AI
@@ -0,0 +1,152 @@
+// This file is part of Sanmill.
+// Copyright (C) 2019-2024 The Sanmill developers (see AUTHORS file)
+//
+// Sanmill is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Sanmill is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+#include "bitboard.h"
+#include "misc.h"
+#include "movegen.h"
+#include "position.h"
+#include "rule.h"
+
+namespace {
+
+// What undo_move() has to restore
+struct Snapshot
+{
+    explicit Snapshot(const Position &pos)
+        : fen(pos.fen())
+        , key(pos.key())
+        , phase(pos.get_phase())
+        , action(pos.get_action())
+        , sideToMove(pos.side_to_move())
+        , gamePly(pos.game_ply())
+        , rule50(pos.rule50_count())
+    {
+        for (Square s = SQ_BEGIN; s < SQ_END; ++s) {
+            board[s] = pos.piece_on(s);
+        }
+
+        for (Color c : {WHITE, BLACK}) {
+            byColorBB[c] = pos.byColorBB[c];
+            onBoard[c] = pos.piece_on_board_count(c);
+            inHand[c] = pos.piece_in_hand_count(c);
+            toRemove[c] = pos.piece_to_remove_count(c);
+        }
+    }
+
+    std::string fen;
+    Key key;
+    Phase phase;
+    Action action;
+    Color sideToMove;
+    int gamePly;
+    unsigned int rule50;
+    Piece board[SQUARE_EXT_NB] {NO_PIECE};
+    Bitboard byColorBB[COLOR_NB] {0};
+    int onBoard[COLOR_NB] {0};
+    int inHand[COLOR_NB] {0};
+    int toRemove[COLOR_NB] {0};
+};
+
+void expect_same(const Snapshot &before, const Position &pos)
+{
+    const Snapshot after(pos);
+
+    EXPECT_EQ(after.fen, before.fen);
+    EXPECT_EQ(after.key, before.key);
+    EXPECT_EQ(after.phase, before.phase);
+    EXPECT_EQ(after.action, before.action);
+    EXPECT_EQ(after.sideToMove, before.sideToMove);
+    EXPECT_EQ(after.gamePly, before.gamePly);
+    EXPECT_EQ(after.rule50, before.rule50);
+
+    for (Square s = SQ_BEGIN; s < SQ_END; ++s) {
+        EXPECT_EQ(after.board[s], before.board[s]) << "square " << s;
+    }
+
+    for (Color c : {WHITE, BLACK}) {
+        EXPECT_EQ(after.byColorBB[c], before.byColorBB[c]);
+        EXPECT_EQ(after.onBoard[c], before.onBoard[c]);
+        EXPECT_EQ(after.inHand[c], before.inHand[c]);
+        EXPECT_EQ(after.toRemove[c], before.toRemove[c]);
+    }
+}
+
+// Play random games under every rule. At each ply every legal move is made and
+// retracted, and at the end the whole game is taken back move by move.
+TEST(PositionTest, undoMoveRestoresPosition)
+{
+    constexpr int Games = 20;
+    constexpr int MaxPlies = 200;
+
+    Bitboards::init();
+    Position::init();
+
+    PRNG rng(1070372);
+
+    for (int r = 0; r < N_RULES; r++) {
+        SCOPED_TRACE(RULES[r].name);
+        set_rule(r);
+
+        for (int g = 0; g < Games; g++) {
+            Position pos;
+            pos.reset();
+            pos.start();
+
+            const Snapshot start(pos);
+            std::vector<StateInfo> states(MaxPlies);
+            std::vector<Move> line;
+
+            while (pos.get_phase() != Phase::gameOver &&
+                   static_cast<int>(line.size()) < MaxPlies) {
+                const MoveList<LEGAL> moves(pos);
+                if (moves.size() == 0) {
+                    break;
+                }
+
+                const Snapshot before(pos);
+
+                for (const ExtMove &m : moves) {
+                    StateInfo st;
+                    pos.do_move(m.move, st);
+                    pos.undo_move(m.move);
+                    expect_same(before, pos);
+                }
+
+                const Move m = moves.begin()[rng.rand<uint64_t>() %
+                                             moves.size()]
+                                   .move;
+                pos.do_move(m, states[line.size()]);
+                line.push_back(m);
+            }
+
+            while (!line.empty()) {
+                pos.undo_move(line.back());
+                line.pop_back();
+            }
+
+            expect_same(start, pos);
+        }
+    }
+
+    set_rule(0);
+}
+
+} // namespace
@@ -0,0 +1,102 @@
+// This file is part of Sanmill.
+// Copyright (C) 2019-2024 The Sanmill developers (see AUTHORS file)
+//
+// Sanmill is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Sanmill is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <mutex>
+
+#include "bitboard.h"
+#include "misc.h"
+#include "movegen.h"
+#include "position.h"
+#include "rule.h"
+#include "search.h"
+#include "thread.h"
+#include "uci.h"
+
+namespace {
+
+constexpr size_t ThreadCount = 4;
+
+// Runs "go depth" with a pool of several threads, as the engine does
+class SearchTest : public ::testing::TestWithParam<const char *>
+{
+protected:
+    static void SetUpTestCase()
+    {
+        UCI::init(Options);
+        Bitboards::init();
+        Position::init();
+        set_rule(0);
+        Threads.set(ThreadCount);
+        Search::clear();
+    }
+
+    static void TearDownTestCase() { Threads.set(0); }
+
+    // Searches fen to depth and returns the move of the main thread. The
+    // position searched may be changed by the move, so root is a copy.
+    Move go_depth(Position &root, Depth depth)
+    {
+        pos.set(GetParam(), Threads.main());
+        root = pos;
+        Threads.main()->us = pos.side_to_move();
+
+        Search::LimitsType limits;
+        limits.startTime = now();
+        limits.depth = depth;
+
+        Threads.start_thinking(&pos, limits, false);
+        Threads.main()->wait_for_search_finished();
+
+        return Threads.main()->bestMove;
+    }
+
+    Position pos;
+};
+
+// The move comes from the main thread or from a helper which went deeper,
+// and must be legal either way. The helpers are stopped and idle once the
+// main thread is done.
+TEST_P(SearchTest, lazySmpGoDepth)
+{
+    ASSERT_EQ(Threads.size(), ThreadCount);
+
+    Position root;
+    const Move m = go_depth(root, 6);
+
+    bool legal = false;
+    for (const ExtMove &em : MoveList<LEGAL>(root)) {
+        legal = legal || em.move == m;
+    }
+    EXPECT_TRUE(legal) << UCI::move(m);
+
+    EXPECT_TRUE(Threads.stop);
+    EXPECT_EQ(Threads.main()->completedDepth, 6);
+
+    for (Thread *th : Threads) {
+        std::lock_guard lk(th->mutex);
+        EXPECT_FALSE(th->searching) << "thread " << th->idx;
+    }
+}
+
+// A placing position and a moving one
+INSTANTIATE_TEST_CASE_P(
+    Positions, SearchTest,
+    ::testing::Values("********/********/******** w p p 0 9 0 9 0 0 1",
+                      "O*O**O**/@@O@O**O/*@O*O*** b m s 8 0 4 0 0 0 0 19"));
+
+} // namespace
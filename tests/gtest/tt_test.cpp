@@ -0,0 +1,134 @@
+// This file is part of Sanmill.
+// Copyright (C) 2019-2024 The Sanmill developers (see AUTHORS file)
+//
+// Sanmill is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Sanmill is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <vector>
+
+#include "tt.h"
+
+#ifdef TRANSPOSITION_TABLE_ENABLE
+
+namespace {
+
+// Every kind of move the data word has to hold
+std::vector<Move> all_moves()
+{
+    std::vector<Move> moves {MOVE_NONE};
+
+    for (Square to = SQ_BEGIN; to < SQ_END; ++to) {
+        moves.push_back(static_cast<Move>(to));
+        moves.push_back(static_cast<Move>(-to));
+
+        for (Square from = SQ_BEGIN; from < SQ_END; ++from) {
+            if (from != to) {
+                moves.push_back(make_move(from, to));
+            }
+        }
+    }
+
+    return moves;
+}
+
+int save(TranspositionTable &tt, Value v, Depth d, Bound b, Key key,
+         Move m = MOVE_NONE)
+{
+#ifdef TT_MOVE_ENABLE
+    return tt.save(v, d, b, key, m);
+#else
+    (void)m;
+    return tt.save(v, d, b, key);
+#endif // TT_MOVE_ENABLE
+}
+
+// Save an entry and read it back through the packed data word
+TEST(TTTest, packUnpackRoundTrip)
+{
+    TranspositionTable tt(1);
+
+    const std::vector<Move> moves = all_moves();
+    Key key = 1;
+
+    for (int v = -VALUE_INFINITE; v <= VALUE_INFINITE; ++v) {
+        for (int d = 0; d <= 31; ++d) {
+            for (Bound b : {BOUND_UPPER, BOUND_LOWER, BOUND_EXACT}) {
+                const Move m = moves[key % moves.size()];
+
+                EXPECT_EQ(save(tt, static_cast<Value>(v),
+                               static_cast<Depth>(d), b, key, m),
+                          0);
+
+                TTEntry tte;
+                ASSERT_TRUE(tt.search(key, tte));
+                EXPECT_EQ(tte.value(), v);
+                EXPECT_EQ(tte.depth(), d);
+                EXPECT_EQ(tte.bound(), b);
+#ifdef TT_MOVE_ENABLE
+                EXPECT_EQ(tte.tt_move(), m);
+#endif // TT_MOVE_ENABLE
+
+                key += 0x9E3779B9;
+            }
+        }
+    }
+}
+
+#ifdef TT_MOVE_ENABLE
+TEST(TTTest, packUnpackAllMoves)
+{
+    TranspositionTable tt(1);
+
+    Key key = 1;
+
+    for (Move m : all_moves()) {
+        save(tt, VALUE_DRAW, 1, BOUND_EXACT, key, m);
+
+        TTEntry tte;
+        ASSERT_TRUE(tt.search(key, tte));
+        EXPECT_EQ(tte.tt_move(), m);
+
+        key += 0x9E3779B9;
+    }
+}
+#endif // TT_MOVE_ENABLE
+
+TEST(TTTest, depthIsClamped)
+{
+    TranspositionTable tt(1);
+
+    TTEntry tte;
+
+    save(tt, VALUE_DRAW, 100, BOUND_EXACT, 1);
+    ASSERT_TRUE(tt.search(1, tte));
+    EXPECT_EQ(tte.depth(), 31);
+
+    save(tt, VALUE_DRAW, -5, BOUND_EXACT, 2);
+    ASSERT_TRUE(tt.search(2, tte));
+    EXPECT_EQ(tte.depth(), 0);
+}
+
+TEST(TTTest, emptyTable)
+{
+    TranspositionTable tt(1);
+
+    TTEntry tte;
+    EXPECT_FALSE(tt.search(1, tte));
+    EXPECT_EQ(tt.hashfull(), 0);
+}
+
+} // namespace
+
+#endif // TRANSPOSITION_TABLE_ENABLE